@@ -7,13 +7,80 @@
 #include <iomanip>
 #include <limits>
 #include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <unordered_map>
+#include <memory>
+#include <string_view>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <list>
+#include <map>
+#include <atomic>
+#include <csignal>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TODO_LIST_AVX2 1
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 using namespace std;
 
 const string USER_FILE = "user_details.txt";
-const string TASKS_DIR = "tasks/";
+const string TASKS_DIR = "tasks/";        // Snapshots (and legacy text files)
+const string INDEX_DIR = TASKS_DIR + "index/";
+const string LOG_DIR = TASKS_DIR + "log/";
+const uintmax_t MIN_FREE_SPACE = 64 << 20; // Warn below this much free disk space
 const int MAX_LOGIN_ATTEMPTS = 3;
 const int MAX_DESCRIPTION_LENGTH = 200;
+const size_t LOG_COMPACT_THRESHOLD = 1 << 20; // Compact the mutation log past 1 MiB
+const size_t BATCH_SNAPSHOT_THRESHOLD = 1 << 20; // Batches logging more than this are saved as a snapshot
+const size_t LOG_HEADER_SIZE = 16; // "TDLW", version, generation
+const chrono::milliseconds PERSIST_COALESCE_DELAY(5); // Edits within this window share one write
+
+// Whether saves are fsynced; only benchmarks turn this off, to measure its cost
+bool syncWrites = true;
+// Whether operations are timed and counted (--metrics); set once at startup
+bool metricsEnabled = false;
+// Threads that scans and sorts of very large task lists are split across
+size_t parallelThreads = max(1u, thread::hardware_concurrency());
+const size_t PARALLEL_THRESHOLD = 1 << 18; // Rows below which they stay on one thread
+const uint32_t LOG_VERSION = 4; // Version 1 stored due dates as text, 1-2 addressed tasks by position, 1-3 had no groups
+const uint32_t SNAPSHOT_VERSION = 2; // Version 1 had no task IDs
+const uint32_t INDEX_VERSION = 5; // Version 1 had no creation-date index, 2 no search index, 3 no counts, 4 kept terms one by one
+const size_t SNAPSHOT_HEADER_SIZE = 48;
+const size_t SNAPSHOT_RECORD_SIZE = 40;
+const size_t SNAPSHOT_V1_HEADER_SIZE = 40;
+const size_t SNAPSHOT_V1_RECORD_SIZE = 32;
+const int32_t DUE_NONE = INT32_MAX; // Day number used for "no due date"
+const size_t COMPACT_MIN_DELETED = 64; // Deleted rows a task store keeps before compacting
+const size_t TEXT_READ_BLOCK = 1 << 20;
+const size_t MAX_REPORTED_ERRORS = 20;
+const size_t MAX_REQUEST_LENGTH = 1 << 16; // Longest server request line
+const size_t DEFAULT_CACHE_MB = 256; // Server memory budget for idle users' tasks
+const size_t PAGE_SIZE = 25; // Tasks per page of the task tables
 
 // Priority levels for tasks
 enum Priority {
@@ -29,172 +96,3995 @@ enum TaskStatus {
     COMPLETED
 };
 
+// Status value of a deleted row until the store is compacted
+const uint8_t STATUS_DELETED = 3;
+
+// Mutation log record types
+enum LogOp {
+    LOG_ADD = 1,
+    LOG_UPDATE = 2,
+    LOG_DELETE = 3,
+    LOG_ORDER = 4, // The task list order was changed
+    LOG_GROUP = 5  // The records of one batch, applied all together or not at all
+};
+
+// Orders the task list can be shown in
+enum TaskOrder {
+    ORDER_LIST,     // Order tasks were added or imported in
+    ORDER_DUE,      // Earliest due date first, no due date last
+    ORDER_PRIORITY, // High to low
+    ORDER_STATUS,   // Pending to completed
+    ORDER_CREATED   // Newest to oldest
+};
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+int32_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Parse "YYYY-MM-DD" straight into a day number; false if it isn't a real date
+bool parse_date(const char* text, size_t length, int32_t& day) {
+    if (length != 10 || text[4] != '-' || text[7] != '-') return false;
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 7) continue;
+        if (text[i] < '0' || text[i] > '9') return false;
+    }
+
+    int year = (text[0] - '0') * 1000 + (text[1] - '0') * 100 + (text[2] - '0') * 10 + (text[3] - '0');
+    int month = (text[5] - '0') * 10 + (text[6] - '0');
+    int dayOfMonth = (text[8] - '0') * 10 + (text[9] - '0');
+
+    if (month < 1 || month > 12) return false;
+    if (dayOfMonth < 1 || dayOfMonth > 31) return false;
+
+    if ((month == 4 || month == 6 || month == 9 || month == 11) && dayOfMonth > 30) return false;
+    if (month == 2) {
+        bool isLeap = (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+        if (dayOfMonth > (isLeap ? 29 : 28)) return false;
+    }
+
+    day = days_from_civil(year, month, dayOfMonth);
+    return true;
+}
+
+// Due dates the app accepts: 2023-01-01 through 2100-12-31
+bool due_day_supported(int32_t day) {
+    return day >= days_from_civil(2023, 1, 1) && day <= days_from_civil(2100, 12, 31);
+}
+
+// "YYYY-MM-DD" for a day number; only used when displaying or exporting
+string day_to_date(int32_t day) {
+    if (day == DUE_NONE) return "";
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp < 10 ? mp + 3 : mp - 9;
+    int y = yoe + era * 400 + (m <= 2);
+
+    char buffer[40];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", y, m, d);
+    return string(buffer);
+}
+
+// Broken-down local time; safe to call from several threads, unlike localtime()
+struct tm local_time(time_t timestamp) {
+    struct tm result;
+    #ifndef _WIN32
+    localtime_r(&timestamp, &result);
+    #else
+    localtime_s(&result, &timestamp);
+    #endif
+    return result;
+}
+
+// Today's day number in local time
+int32_t current_day() {
+    struct tm timeinfo = local_time(time(0));
+    return days_from_civil(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
+}
+
+string priority_string(Priority priority) {
+    switch (priority) {
+        case LOW: return "Low";
+        case MEDIUM: return "Medium";
+        case HIGH: return "High";
+        default: return "Unknown";
+    }
+}
+
+string status_string(TaskStatus status) {
+    switch (status) {
+        case PENDING: return "Pending";
+        case IN_PROGRESS: return "In Progress";
+        case COMPLETED: return "Completed";
+        default: return "Unknown";
+    }
+}
+
+// Format a timestamp as YYYY-MM-DD in local time
+string format_timestamp(time_t timestamp) {
+    struct tm timeinfo = local_time(timestamp);
+    char buffer[80];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d", &timeinfo);
+    return string(buffer);
+}
+
+// Operations the metrics are kept for
+enum MetricOp {
+    METRIC_LOAD,   // Load a user's tasks: snapshot, index and log replay
+    METRIC_SAVE,   // Encode a snapshot and queue it (on the caller)
+    METRIC_WRITE,  // Write and fsync a snapshot and its index, encoding it first
+                   // for a log compaction (writer thread)
+    METRIC_SYNC,   // Flush and fsync a round of log records (writer thread)
+    METRIC_SORT,   // Read a list order off its index
+    METRIC_FILTER,
+    METRIC_SEARCH,
+    METRIC_STATS,
+    METRIC_LOGIN,  // Check a user ID and password
+    METRIC_OP_COUNT
+};
+
+const char* const METRIC_NAMES[METRIC_OP_COUNT] = {
+    "load", "save", "write", "sync", "sort", "filter", "search", "stats", "login"};
+
+// Allocations made by this thread while metrics are on
+thread_local uint64_t threadAllocations = 0;
+
+// Every allocation comes through these two so the metrics can count it.
+// All the other forms are replaced too and call them, and every delete
+// calls free(), so memory from any new can go to any delete even where the
+// library or a sanitizer brings its own versions of the forms left out.
+void* operator new(size_t size) {
+    if (metricsEnabled) threadAllocations++;
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* p = malloc(size)) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    if (metricsEnabled) threadAllocations++;
+    if (size == 0) size = 1;
+    size_t align = max(static_cast<size_t>(alignment), sizeof(void*));
+    while (true) {
+        void* p;
+        if (posix_memalign(&p, align, size) == 0) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try {
+        return ::operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    try {
+        return ::operator new(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return ::operator new(size, nothrow);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return ::operator new(size, alignment, nothrow);
+}
+
+// Kept out of line: inlined next to operator new, GCC reports the free()
+// as mismatched with it
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete(void* p, align_val_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete[](void* p) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete[](void* p, align_val_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete[](void* p, size_t, align_val_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept {
+    ::operator delete(p);
+}
+
+// Latencies in log-spaced buckets, four per power of two of nanoseconds, so
+// a percentile is within 25% of the true value. Recording is lock-free.
+class LatencyHistogram {
+public:
+    static const size_t BUCKETS = 64 * 4;
+
+    void record(uint64_t ns) {
+        buckets[bucketFor(ns)].fetch_add(1, memory_order_relaxed);
+        samples.fetch_add(1, memory_order_relaxed);
+        uint64_t longest = maxNs.load(memory_order_relaxed);
+        while (ns > longest && !maxNs.compare_exchange_weak(longest, ns, memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const {
+        return samples.load(memory_order_relaxed);
+    }
+
+    uint64_t longest() const {
+        return maxNs.load(memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double p) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(total * p / 100 + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += buckets[i].load(memory_order_relaxed);
+            if (seen >= rank) return min(upperBound(i), longest());
+        }
+        return longest();
+    }
+
+private:
+    atomic<uint64_t> buckets[BUCKETS] = {};
+    atomic<uint64_t> samples{0};
+    atomic<uint64_t> maxNs{0};
+
+    // Values below 4 get their own bucket; above that the two bits after the
+    // leading one pick one of four buckets per power of two
+    static size_t bucketFor(uint64_t ns) {
+        if (ns < 4) return static_cast<size_t>(ns);
+        int octave = 63 - __builtin_clzll(ns);
+        return static_cast<size_t>(octave) * 4 + ((ns >> (octave - 2)) & 3);
+    }
+
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket < 4) return bucket;
+        int octave = static_cast<int>(bucket / 4);
+        uint64_t width = uint64_t(1) << (octave - 2);
+        return (4 + bucket % 4) * width + width - 1;
+    }
+};
+
+// Process-wide latency, allocation and I/O counters. Everything is a no-op
+// unless metricsEnabled is set, so the cost when off is one branch.
+class Metrics {
+public:
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    void record(MetricOp op, uint64_t ns, uint64_t allocations) {
+        operations[op].latency.record(ns);
+        operations[op].allocations.fetch_add(allocations, memory_order_relaxed);
+    }
+
+    static void read(size_t bytes) {
+        if (metricsEnabled) instance().bytesRead.fetch_add(bytes, memory_order_relaxed);
+    }
+
+    static void written(size_t bytes) {
+        if (metricsEnabled) instance().bytesWritten.fetch_add(bytes, memory_order_relaxed);
+    }
+
+    // A table for people: one row per operation that has run
+    string report() const {
+        ostringstream out;
+        out << left << setw(10) << "Operation" << right << setw(10) << "Count" << setw(12) << "p50"
+            << setw(12) << "p99" << setw(12) << "Max" << setw(12) << "Allocs/op" << "\n";
+        for (size_t op = 0; op < METRIC_OP_COUNT; op++) {
+            const OperationMetrics& m = operations[op];
+            uint64_t count = m.latency.count();
+            if (count == 0) continue;
+            out << left << setw(10) << METRIC_NAMES[op] << right << setw(10) << count
+                << setw(12) << formatDuration(m.latency.percentile(50))
+                << setw(12) << formatDuration(m.latency.percentile(99))
+                << setw(12) << formatDuration(m.latency.longest())
+                << setw(12) << m.allocations.load(memory_order_relaxed) / count << "\n";
+        }
+        out << "Bytes read: " << bytesRead.load(memory_order_relaxed)
+            << ", bytes written: " << bytesWritten.load(memory_order_relaxed) << "\n";
+        return out.str();
+    }
+
+    // The same as key=value lines for the server, latencies in microseconds
+    vector<string> lines() const {
+        vector<string> result;
+        for (size_t op = 0; op < METRIC_OP_COUNT; op++) {
+            const OperationMetrics& m = operations[op];
+            uint64_t count = m.latency.count();
+            if (count == 0) continue;
+            result.push_back(string(METRIC_NAMES[op]) + " count=" + to_string(count)
+                             + " p50_us=" + to_string(m.latency.percentile(50) / 1000)
+                             + " p99_us=" + to_string(m.latency.percentile(99) / 1000)
+                             + " max_us=" + to_string(m.latency.longest() / 1000)
+                             + " allocs=" + to_string(m.allocations.load(memory_order_relaxed)));
+        }
+        result.push_back("io bytes_read=" + to_string(bytesRead.load(memory_order_relaxed))
+                         + " bytes_written=" + to_string(bytesWritten.load(memory_order_relaxed)));
+        return result;
+    }
+
+private:
+    struct OperationMetrics {
+        LatencyHistogram latency;
+        atomic<uint64_t> allocations{0};
+    };
+
+    OperationMetrics operations[METRIC_OP_COUNT];
+    atomic<uint64_t> bytesRead{0};
+    atomic<uint64_t> bytesWritten{0};
+
+    Metrics() = default;
+
+    static string formatDuration(uint64_t ns) {
+        char text[32];
+        if (ns < 1000) {
+            snprintf(text, sizeof(text), "%llu ns", static_cast<unsigned long long>(ns));
+        } else if (ns < 1000000) {
+            snprintf(text, sizeof(text), "%.1f us", ns / 1e3);
+        } else if (ns < 1000000000) {
+            snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+        } else {
+            snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+        }
+        return text;
+    }
+};
+
+// Times the enclosing scope as one op and counts the allocations this
+// thread makes in it
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricOp metric) : op(metric), active(metricsEnabled) {
+        if (active) {
+            allocations = threadAllocations;
+            start = chrono::steady_clock::now();
+        }
+    }
+
+    ~MetricTimer() {
+        if (active) {
+            chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+            Metrics::instance().record(op, elapsed.count(), threadAllocations - allocations);
+        }
+    }
+
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+private:
+    MetricOp op;
+    bool active;
+    uint64_t allocations = 0;
+    chrono::steady_clock::time_point start;
+};
+
 class Task {
 public:
+    uint64_t id; // Stable task ID, 0 until the task is stored
     string description;
-    string dueDate;
+    int32_t dueDay; // Days since 1970-01-01, DUE_NONE for no due date
     Priority priority;
     TaskStatus status;
     time_t createdDate;
     time_t completedDate;
 
-    Task() {
-        description = "";
-        dueDate = "";
-        priority = MEDIUM;
-        status = PENDING;
-        createdDate = time(0);
-        completedDate = 0;
+    Task() {
+        id = 0;
+        description = "";
+        dueDay = DUE_NONE;
+        priority = MEDIUM;
+        status = PENDING;
+        createdDate = time(0);
+        completedDate = 0;
+    }
+
+    Task(const string& desc, int32_t due, Priority prio) {
+        id = 0;
+        description = desc;
+        dueDay = due;
+        priority = prio;
+        status = PENDING;
+        createdDate = time(0);
+        completedDate = 0;
+    }
+
+    string getPriorityString() const {
+        return priority_string(priority);
+    }
+
+    string getStatusString() const {
+        return status_string(status);
+    }
+
+    string getFormattedDate(time_t timestamp) const {
+        return format_timestamp(timestamp);
+    }
+
+    string getDueDateString() const {
+        return dueDay == DUE_NONE ? "None" : day_to_date(dueDay);
+    }
+};
+
+// CRC-32 (IEEE 802.3) checksum, eight bytes per step (slicing-by-8): table
+// k gives the CRC of a byte followed by k zero bytes
+uint32_t crc32(const char* data, size_t length, uint32_t crc = 0) {
+    static const vector<uint32_t> table = [] {
+        vector<uint32_t> t(8 * 256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        for (size_t i = 256; i < t.size(); i++) {
+            t[i] = (t[i - 256] >> 8) ^ t[t[i - 256] & 0xFF];
+        }
+        return t;
+    }();
+    const uint32_t* t = table.data();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+    crc = ~crc;
+    for (; length >= 8; p += 8, length -= 8) {
+        uint32_t low = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24);
+        uint32_t high = p[4] | p[5] << 8 | p[6] << 16 | static_cast<uint32_t>(p[7]) << 24;
+        crc = t[7 * 256 + (low & 0xFF)] ^ t[6 * 256 + ((low >> 8) & 0xFF)] ^
+              t[5 * 256 + ((low >> 16) & 0xFF)] ^ t[4 * 256 + (low >> 24)] ^
+              t[3 * 256 + (high & 0xFF)] ^ t[2 * 256 + ((high >> 8) & 0xFF)] ^
+              t[1 * 256 + ((high >> 16) & 0xFF)] ^ t[high >> 24];
+    }
+    for (; length > 0; p++, length--) {
+        crc = t[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Little-endian encoding helpers for the binary file formats
+void put_u8(string& out, uint8_t v) {
+    out.push_back(static_cast<char>(v));
+}
+
+void put_u32(string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void put_u64(string& out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void put_str(string& out, const string& v) {
+    put_u32(out, static_cast<uint32_t>(v.size()));
+    out += v;
+}
+
+// Unsigned LEB128: 7 bits per byte, high bit set on all but the last
+void put_varint(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// Bounds-checked reader over a byte buffer; ok turns false on overrun
+struct ByteReader {
+    const char* p;
+    const char* end;
+    bool ok;
+
+    ByteReader(const char* data, size_t length) : p(data), end(data + length), ok(true) {}
+
+    bool has(size_t n) {
+        if (!ok || static_cast<size_t>(end - p) < n) ok = false;
+        return ok;
+    }
+
+    uint8_t u8() {
+        if (!has(1)) return 0;
+        return static_cast<uint8_t>(*p++);
+    }
+
+    uint32_t u32() {
+        if (!has(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        p += 4;
+        return v;
+    }
+
+    uint64_t u64() {
+        if (!has(8)) return 0;
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        p += 8;
+        return v;
+    }
+
+    string str() {
+        uint32_t n = u32();
+        if (!has(n)) return "";
+        string v(p, n);
+        p += n;
+        return v;
+    }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64 && has(1); shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+// Read-only view of a whole file, memory-mapped where the platform allows it
+class MappedFile {
+public:
+    const char* data;
+    size_t size;
+
+    explicit MappedFile(const string& path) : data(nullptr), size(0), mapped(false) {
+        #ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const char*>(p);
+                size = st.st_size;
+                mapped = true;
+                Metrics::read(size);
+            }
+        }
+        close(fd);
+        #else
+        ifstream inFile(path, ios::binary);
+        if (!inFile.is_open()) return;
+        buffer.assign(istreambuf_iterator<char>(inFile), istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+        Metrics::read(size);
+        #endif
+    }
+
+    ~MappedFile() {
+        #ifndef _WIN32
+        if (mapped) munmap(const_cast<char*>(data), size);
+        #endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const {
+        return data != nullptr;
+    }
+
+private:
+    bool mapped;
+    string buffer;
+};
+
+// Parse a whole field as a number; false on junk or overflow
+template <typename T>
+bool parse_number(const char* text, size_t length, T& value) {
+    auto result = from_chars(text, text + length, value);
+    return result.ec == errc() && result.ptr == text + length;
+}
+
+// Case-insensitive comparison against a lowercase keyword
+bool equals_keyword(string_view text, const char* keyword) {
+    size_t n = strlen(keyword);
+    if (text.size() != n) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (tolower(static_cast<unsigned char>(text[i])) != keyword[i]) return false;
+    }
+    return true;
+}
+
+// Priority from "1"-"3" or low/medium/high
+bool parse_priority(string_view text, Priority& priority) {
+    if (text == "1" || equals_keyword(text, "low")) priority = LOW;
+    else if (text == "2" || equals_keyword(text, "medium")) priority = MEDIUM;
+    else if (text == "3" || equals_keyword(text, "high")) priority = HIGH;
+    else return false;
+    return true;
+}
+
+// Status from "1"-"3" (as in the menus) or pending/in-progress/completed
+bool parse_status(string_view text, TaskStatus& status) {
+    if (text == "1" || equals_keyword(text, "pending")) status = PENDING;
+    else if (text == "2" || equals_keyword(text, "in-progress") || equals_keyword(text, "in progress")) status = IN_PROGRESS;
+    else if (text == "3" || equals_keyword(text, "completed")) status = COMPLETED;
+    else return false;
+    return true;
+}
+
+// Keyword form of a priority or status, as written by exports
+const char* priority_keyword(Priority priority) {
+    return priority == LOW ? "low" : (priority == HIGH ? "high" : "medium");
+}
+
+const char* status_keyword(TaskStatus status) {
+    return status == PENDING ? "pending" : (status == IN_PROGRESS ? "in-progress" : "completed");
+}
+
+// File formats for import and export
+enum TaskFormat {
+    FORMAT_TEXT,  // Pipe-delimited, as in the legacy task files
+    FORMAT_CSV,   // description,due_date,priority,status,created,completed
+    FORMAT_JSONL  // One JSON object per line
+};
+
+bool parse_format(const string& name, TaskFormat& format) {
+    if (name == "txt" || name == "text") format = FORMAT_TEXT;
+    else if (name == "csv") format = FORMAT_CSV;
+    else if (name == "jsonl" || name == "ndjson" || name == "json") format = FORMAT_JSONL;
+    else return false;
+    return true;
+}
+
+// Format implied by a file name's extension; CSV if there is none we know
+TaskFormat format_for_path(const string& path) {
+    TaskFormat format = FORMAT_CSV;
+    size_t dot = path.rfind('.');
+    if (dot != string::npos) {
+        parse_format(path.substr(dot + 1), format);
+    }
+    return format;
+}
+
+// Base for the streaming task readers: block-buffered line splitting and
+// line-numbered error reporting. Only a bounded buffer is held in memory,
+// however large the input.
+class TaskReader {
+public:
+    size_t errorCount;
+    vector<string> errors;  // First MAX_REPORTED_ERRORS messages
+    bool strictDates;       // Also require due dates in the range the app accepts
+
+    explicit TaskReader(istream& input)
+        : errorCount(0), strictDates(false), lineNumber(0), in(input),
+          buffer(TEXT_READ_BLOCK), pos(0), len(0), eof(false) {}
+
+    virtual ~TaskReader() {}
+
+    // Parse the next valid task into task; returns false at end of input.
+    // Malformed records are skipped and reported.
+    virtual bool next(Task& task) = 0;
+
+protected:
+    size_t lineNumber;
+
+    void report(const string& reason) {
+        if (errorCount++ < MAX_REPORTED_ERRORS) {
+            errors.push_back("line " + to_string(lineNumber) + ": " + reason);
+        }
+    }
+
+    // Next line without its terminator; valid until the following call
+    bool nextLine(const char*& line, size_t& length) {
+        while (true) {
+            const char* start = buffer.data() + pos;
+            const char* newline = static_cast<const char*>(memchr(start, '\n', len - pos));
+            if (newline || (eof && pos < len)) {
+                line = start;
+                length = (newline ? newline : buffer.data() + len) - start;
+                pos += length + (newline ? 1 : 0);
+                lineNumber++;
+                if (length > 0 && line[length - 1] == '\r') length--;
+                return true;
+            }
+            if (eof) {
+                return false;
+            }
+
+            // Keep the partial line and refill the rest of the block
+            size_t rest = len - pos;
+            memmove(buffer.data(), start, rest);
+            if (rest == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            in.read(buffer.data() + rest, buffer.size() - rest);
+            Metrics::read(static_cast<size_t>(in.gcount()));
+            len = rest + static_cast<size_t>(in.gcount());
+            pos = 0;
+            if (!in) eof = true;
+        }
+    }
+
+    bool checkDueDate(string_view text, int32_t& day) {
+        day = DUE_NONE;
+        if (text.empty()) return true;
+        if (!parse_date(text.data(), text.size(), day)) {
+            report("invalid due date '" + string(text) + "'");
+            return false;
+        }
+        if (strictDates && !due_day_supported(day)) {
+            report("due date " + string(text) + " is outside 2023-2100");
+            return false;
+        }
+        return true;
+    }
+
+    // Fill task from loosely typed fields (CSV and JSON). Everything but the
+    // description is optional.
+    bool fillTask(Task& task, string_view description, string_view due, string_view priority,
+                  string_view status, string_view created, string_view completed) {
+        if (description.empty() || description.size() > static_cast<size_t>(MAX_DESCRIPTION_LENGTH)) {
+            report(description.empty() ? "missing description" : "description longer than " +
+                   to_string(MAX_DESCRIPTION_LENGTH) + " characters");
+            return false;
+        }
+        if (!checkDueDate(due, task.dueDay)) {
+            return false;
+        }
+        task.priority = MEDIUM;
+        if (!priority.empty() && !parse_priority(priority, task.priority)) {
+            report("invalid priority '" + string(priority) + "'");
+            return false;
+        }
+        task.status = PENDING;
+        if (!status.empty() && !parse_status(status, task.status)) {
+            report("invalid status '" + string(status) + "'");
+            return false;
+        }
+
+        long long createdValue = time(0), completedValue = 0;
+        if ((!created.empty() && !parse_number(created.data(), created.size(), createdValue)) ||
+            (!completed.empty() && !parse_number(completed.data(), completed.size(), completedValue))) {
+            report("invalid timestamp");
+            return false;
+        }
+        if (task.status == COMPLETED && completed.empty()) {
+            completedValue = time(0);
+        }
+        task.createdDate = static_cast<time_t>(createdValue);
+        task.completedDate = static_cast<time_t>(completedValue);
+        task.description.assign(description.data(), description.size());
+        return true;
+    }
+
+private:
+    istream& in;
+    vector<char> buffer;
+    size_t pos;
+    size_t len;
+    bool eof;
+};
+
+// Streaming parser for the pipe-delimited text format.
+// Splits lines and fields in place, so the only per-task allocation is the
+// description itself.
+class TextTaskReader : public TaskReader {
+public:
+    uint64_t generation; // From the "#TDL|<gen>" header, if present
+
+    explicit TextTaskReader(istream& input) : TaskReader(input), generation(0) {}
+
+    bool next(Task& task) override {
+        const char* line;
+        size_t length;
+        while (nextLine(line, length)) {
+            if (length == 0) continue;
+            if (line[0] == '#') {
+                if (length > 5 && memcmp(line, "#TDL|", 5) == 0 &&
+                    !parse_number(line + 5, length - 5, generation)) {
+                    report("bad header");
+                }
+                continue;
+            }
+            if (parseLine(line, length, task)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool parseLine(const char* line, size_t length, Task& task) {
+        const char* fields[6];
+        size_t sizes[6];
+        const char* p = line;
+        const char* end = line + length;
+        int count = 0;
+        while (count < 6) {
+            const char* bar = static_cast<const char*>(memchr(p, '|', end - p));
+            fields[count] = p;
+            sizes[count] = (bar ? bar : end) - p;
+            count++;
+            if (!bar) break;
+            p = bar + 1;
+        }
+        if (count < 6) {
+            report("expected 6 fields, found " + to_string(count));
+            return false;
+        }
+
+        int32_t due;
+        if (!checkDueDate(string_view(fields[1], sizes[1]), due)) {
+            return false;
+        }
+
+        int priority, status;
+        long long created, completed;
+        if (!parse_number(fields[2], sizes[2], priority) || priority < LOW || priority > HIGH) {
+            report("invalid priority");
+            return false;
+        }
+        if (!parse_number(fields[3], sizes[3], status) || status < PENDING || status > COMPLETED) {
+            report("invalid status");
+            return false;
+        }
+        if (!parse_number(fields[4], sizes[4], created) || !parse_number(fields[5], sizes[5], completed)) {
+            report("invalid timestamp");
+            return false;
+        }
+
+        task.description.assign(fields[0], sizes[0]);
+        task.dueDay = due;
+        task.priority = static_cast<Priority>(priority);
+        task.status = static_cast<TaskStatus>(status);
+        task.createdDate = static_cast<time_t>(created);
+        task.completedDate = static_cast<time_t>(completed);
+        return true;
+    }
+};
+
+// Streaming CSV reader (RFC 4180 quoting, quoted fields may span lines).
+// Columns: description,due_date,priority,status,created,completed; a header
+// row starting with "description" is skipped.
+class CsvTaskReader : public TaskReader {
+public:
+    explicit CsvTaskReader(istream& input) : TaskReader(input), fieldCount(0), firstRecord(true) {}
+
+    bool next(Task& task) override {
+        const char* line;
+        size_t length;
+        while (nextLine(line, length)) {
+            if (length == 0) continue;
+
+            if (!split(line, length)) {
+                // A quoted field continues on the next line(s)
+                record.assign(line, length);
+                size_t startLine = lineNumber;
+                bool complete = false;
+                while (!complete && nextLine(line, length)) {
+                    record += '\n';
+                    record.append(line, length);
+                    complete = split(record.data(), record.size());
+                }
+                if (!complete) {
+                    lineNumber = startLine;
+                    report("unterminated quoted field");
+                    return false;
+                }
+            }
+
+            if (firstRecord) {
+                firstRecord = false;
+                if (equals_keyword(fields[0], "description")) continue;
+            }
+            if (fieldCount > 6) {
+                report("expected at most 6 fields, found " + to_string(fieldCount));
+                continue;
+            }
+            string_view empty;
+            if (fillTask(task, fields[0],
+                         fieldCount > 1 ? string_view(fields[1]) : empty,
+                         fieldCount > 2 ? string_view(fields[2]) : empty,
+                         fieldCount > 3 ? string_view(fields[3]) : empty,
+                         fieldCount > 4 ? string_view(fields[4]) : empty,
+                         fieldCount > 5 ? string_view(fields[5]) : empty)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    vector<string> fields; // Reused between records
+    size_t fieldCount;
+    string record;
+    bool firstRecord;
+
+    // Split one record into fields; false if it ends inside quotes
+    bool split(const char* p, size_t length) {
+        const char* end = p + length;
+        fieldCount = 0;
+        while (true) {
+            if (fieldCount == fields.size()) fields.emplace_back();
+            string& field = fields[fieldCount++];
+            field.clear();
+
+            if (p < end && *p == '"') {
+                p++;
+                while (true) {
+                    if (p == end) return false;
+                    if (*p == '"') {
+                        if (p + 1 < end && p[1] == '"') {
+                            field += '"';
+                            p += 2;
+                            continue;
+                        }
+                        p++;
+                        break;
+                    }
+                    field += *p++;
+                }
+                // Anything between the closing quote and the comma is kept as-is
+                while (p < end && *p != ',') field += *p++;
+            } else {
+                const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+                const char* stop = comma ? comma : end;
+                field.assign(p, stop);
+                p = stop;
+            }
+
+            if (p == end) return true;
+            p++; // Skip the comma
+        }
+    }
+};
+
+// Streaming JSON Lines reader: one flat object per line with the keys
+// description, due (or due_date), priority, status, created and completed.
+// Unknown keys are ignored; null means "not given".
+class JsonTaskReader : public TaskReader {
+public:
+    explicit JsonTaskReader(istream& input) : TaskReader(input) {}
+
+    bool next(Task& task) override {
+        const char* line;
+        size_t length;
+        while (nextLine(line, length)) {
+            p = line;
+            end = line + length;
+            skipSpace();
+            if (p == end) continue;
+
+            for (auto& value : values) value.clear();
+            string error;
+            if (!parseObject(error)) {
+                report(error);
+                continue;
+            }
+            if (fillTask(task, values[0], values[1], values[2], values[3], values[4], values[5])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const char* p;
+    const char* end;
+    string key;
+    string values[6]; // description, due, priority, status, created, completed
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+    }
+
+    bool parseObject(string& error) {
+        if (*p++ != '{') {
+            error = "expected a JSON object";
+            return false;
+        }
+        skipSpace();
+        if (p < end && *p == '}') {
+            p++;
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            if (!parseString(key)) {
+                error = "expected a quoted key";
+                return false;
+            }
+            skipSpace();
+            if (p == end || *p++ != ':') {
+                error = "expected ':' after \"" + key + "\"";
+                return false;
+            }
+            skipSpace();
+
+            string* slot = nullptr;
+            if (key == "description") slot = &values[0];
+            else if (key == "due" || key == "due_date") slot = &values[1];
+            else if (key == "priority") slot = &values[2];
+            else if (key == "status") slot = &values[3];
+            else if (key == "created") slot = &values[4];
+            else if (key == "completed") slot = &values[5];
+            string ignored;
+            if (!parseValue(slot ? *slot : ignored)) {
+                error = "invalid value for \"" + key + "\"";
+                return false;
+            }
+
+            skipSpace();
+            if (p < end && *p == ',') {
+                p++;
+                continue;
+            }
+            if (p < end && *p == '}') {
+                p++;
+                skipSpace();
+                if (p != end) {
+                    error = "unexpected text after the object";
+                    return false;
+                }
+                return true;
+            }
+            error = "expected ',' or '}'";
+            return false;
+        }
+    }
+
+    // Strings are unescaped into out; numbers and booleans are copied as
+    // written; null leaves out empty
+    bool parseValue(string& out) {
+        if (p == end) return false;
+        if (*p == '"') return parseString(out);
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t') p++;
+        string_view token(start, p - start);
+        if (token == "null") {
+            out.clear();
+            return true;
+        }
+        if (token.empty()) return false;
+        out.assign(token.data(), token.size());
+        return true;
+    }
+
+    bool parseString(string& out) {
+        out.clear();
+        if (p == end || *p != '"') return false;
+        p++;
+        while (p < end && *p != '"') {
+            if (*p != '\\') {
+                out += *p++;
+                continue;
+            }
+            if (++p == end) return false;
+            char c = *p++;
+            switch (c) {
+                case '"': case '\\': case '/': out += c; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t code = 0;
+                    if (!parseHex4(code)) return false;
+                    if (code >= 0xD800 && code < 0xDC00) {
+                        uint32_t low = 0;
+                        if (end - p < 6 || p[0] != '\\' || p[1] != 'u') return false;
+                        p += 2;
+                        if (!parseHex4(low) || low < 0xDC00 || low > 0xDFFF) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        if (p == end) return false;
+        p++; // Closing quote
+        return true;
+    }
+
+    bool parseHex4(uint32_t& code) {
+        if (end - p < 4) return false;
+        auto result = from_chars(p, p + 4, code, 16);
+        if (result.ptr != p + 4) return false;
+        p += 4;
+        return true;
+    }
+
+    static void appendUtf8(string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+unique_ptr<TaskReader> make_task_reader(istream& in, TaskFormat format) {
+    switch (format) {
+        case FORMAT_TEXT: return unique_ptr<TaskReader>(new TextTaskReader(in));
+        case FORMAT_JSONL: return unique_ptr<TaskReader>(new JsonTaskReader(in));
+        default: return unique_ptr<TaskReader>(new CsvTaskReader(in));
+    }
+}
+
+// Append one task to out in the given export format
+void append_task(string& out, const Task& task, TaskFormat format) {
+    string due = day_to_date(task.dueDay);
+    switch (format) {
+        case FORMAT_TEXT:
+            // The text format has no quoting, so separators in descriptions become spaces
+            for (char c : task.description) {
+                out += (c == '|' || c == '\n' || c == '\r') ? ' ' : c;
+            }
+            out += "|" + due + "|"
+                 + to_string(static_cast<int>(task.priority)) + "|"
+                 + to_string(static_cast<int>(task.status)) + "|"
+                 + to_string(task.createdDate) + "|"
+                 + to_string(task.completedDate) + "\n";
+            break;
+
+        case FORMAT_CSV:
+            if (task.description.find_first_of(",\"\r\n") != string::npos) {
+                out += '"';
+                for (char c : task.description) {
+                    if (c == '"') out += '"';
+                    out += c;
+                }
+                out += '"';
+            } else {
+                out += task.description;
+            }
+            out += "," + due + "," + priority_keyword(task.priority) + "," + status_keyword(task.status)
+                 + "," + to_string(task.createdDate) + "," + to_string(task.completedDate) + "\n";
+            break;
+
+        case FORMAT_JSONL:
+            out += "{\"description\":\"";
+            for (char c : task.description) {
+                unsigned char u = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                    out += c;
+                } else if (c == '\n') {
+                    out += "\\n";
+                } else if (c == '\r') {
+                    out += "\\r";
+                } else if (c == '\t') {
+                    out += "\\t";
+                } else if (u < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", u);
+                    out += escape;
+                } else {
+                    out += c;
+                }
+            }
+            out += "\",\"due\":" + (due.empty() ? string("null") : "\"" + due + "\"")
+                 + ",\"priority\":\"" + priority_keyword(task.priority)
+                 + "\",\"status\":\"" + status_keyword(task.status)
+                 + "\",\"created\":" + to_string(task.createdDate)
+                 + ",\"completed\":" + to_string(task.completedDate) + "}\n";
+            break;
+    }
+}
+
+// Status, priority and overdue histograms over the task columns
+struct TaskCounts {
+    size_t byStatus[4];   // Indexed by TaskStatus; [3] absorbs deleted rows
+    size_t byPriority[4]; // Indexed by Priority (LOW..HIGH)
+    size_t overdue;       // Due before today and not completed
+};
+
+// Portable one-pass counting loop
+TaskCounts count_tasks_scalar(const uint8_t* status, const uint8_t* priority,
+                              const int32_t* due, size_t n, int32_t today) {
+    TaskCounts counts = {};
+    for (size_t i = 0; i < n; i++) {
+        counts.byStatus[status[i] & 3]++;
+        counts.byPriority[priority[i] & 3]++;
+        counts.overdue += (due[i] < today) & (status[i] != COMPLETED);
+    }
+    return counts;
+}
+
+#ifdef TODO_LIST_AVX2
+// AVX2 kernel: 32 tasks per iteration. Byte compares on the status and
+// priority columns become bit masks that are popcounted; the due-day column
+// is compared 8 lanes at a time and masked with "not completed".
+__attribute__((target("avx2,popcnt")))
+TaskCounts count_tasks_avx2(const uint8_t* status, const uint8_t* priority,
+                            const int32_t* due, size_t n, int32_t today) {
+    TaskCounts counts = {};
+    const __m256i pending = _mm256_set1_epi8(PENDING);
+    const __m256i inProgress = _mm256_set1_epi8(IN_PROGRESS);
+    const __m256i completed = _mm256_set1_epi8(COMPLETED);
+    const __m256i low = _mm256_set1_epi8(LOW);
+    const __m256i medium = _mm256_set1_epi8(MEDIUM);
+    const __m256i high = _mm256_set1_epi8(HIGH);
+    const __m256i todayLanes = _mm256_set1_epi32(today);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i st = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(status + i));
+        __m256i pr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(priority + i));
+
+        uint32_t done = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(st, completed)));
+        counts.byStatus[PENDING] += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(st, pending))));
+        counts.byStatus[IN_PROGRESS] += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(st, inProgress))));
+        counts.byStatus[COMPLETED] += _mm_popcnt_u32(done);
+        counts.byPriority[LOW] += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(pr, low))));
+        counts.byPriority[MEDIUM] += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(pr, medium))));
+        counts.byPriority[HIGH] += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(pr, high))));
+
+        uint32_t late = 0;
+        for (int k = 0; k < 4; k++) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(due + i + 8 * k));
+            __m256i before = _mm256_cmpgt_epi32(todayLanes, d);
+            late |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(before))) << (8 * k);
+        }
+        counts.overdue += _mm_popcnt_u32(late & ~done);
+    }
+
+    TaskCounts tail = count_tasks_scalar(status + i, priority + i, due + i, n - i, today);
+    for (int k = 0; k < 3; k++) counts.byStatus[k] += tail.byStatus[k];
+    for (int k = 0; k < 4; k++) counts.byPriority[k] += tail.byPriority[k];
+    counts.overdue += tail.overdue;
+    return counts;
+}
+#endif
+
+// Count with the fastest kernel the CPU supports
+TaskCounts count_tasks(const uint8_t* status, const uint8_t* priority,
+                       const int32_t* due, size_t n, int32_t today) {
+    #ifdef TODO_LIST_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    if (hasAvx2) {
+        return count_tasks_avx2(status, priority, due, n, today);
+    }
+    #endif
+    return count_tasks_scalar(status, priority, due, n, today);
+}
+
+// Flush a file's data to stable storage
+bool sync_file(FILE* file) {
+    if (fflush(file) != 0) return false;
+    #ifndef _WIN32
+    if (syncWrites && fsync(fileno(file)) != 0) return false;
+    #endif
+    return true;
+}
+
+// Make a rename or create in path's directory durable
+void sync_directory(const string& path) {
+    #ifndef _WIN32
+    if (!syncWrites) return;
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : path.substr(0, slash + 1);
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    #endif
+}
+
+// Advisory lock on an open file, shared or exclusive, held until the file
+// is closed; it only keeps out processes that take it too
+void lock_file(FILE* file, bool exclusive) {
+    #ifndef _WIN32
+    while (flock(fileno(file), exclusive ? LOCK_EX : LOCK_SH) != 0 && errno == EINTR) {}
+    #endif
+}
+
+// Write a file atomically: temp file, fsync, rename over the old one
+bool write_file_atomic(const string& path, const string& data) {
+    string tmpPath = path + ".tmp";
+    FILE* outFile = fopen(tmpPath.c_str(), "wb");
+    if (!outFile) {
+        return false;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), outFile) == data.size() && sync_file(outFile);
+    Metrics::written(data.size());
+    written = fclose(outFile) == 0 && written;
+    if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    sync_directory(path);
+    return true;
+}
+
+// Keep the current version of path as <path>.prev before it is replaced.
+// A hard link, so path itself never goes missing.
+void keep_previous(const string& path) {
+    string prevPath = path + ".prev";
+    #ifndef _WIN32
+    string tmpPath = prevPath + ".tmp";
+    remove(tmpPath.c_str());
+    if (link(path.c_str(), tmpPath.c_str()) == 0) {
+        rename(tmpPath.c_str(), prevPath.c_str());
+    }
+    #else
+    ifstream current(path, ios::binary);
+    if (current.is_open()) {
+        string data((istreambuf_iterator<char>(current)), istreambuf_iterator<char>());
+        write_file_atomic(prevPath, data);
+    }
+    #endif
+}
+
+// Write a snapshot and its index, keeping the snapshot it replaces as the
+// fallback generation, then drop logs that no kept snapshot needs
+void write_snapshot_file(const string& path, const string& data,
+                         const string& indexPath, const string& indexData,
+                         const vector<string>& obsoleteLogs) {
+    if (!write_file_atomic(indexPath, indexData)) {
+        cerr << "Warning: Unable to save task index." << endl;
+    }
+    keep_previous(path);
+    if (!write_file_atomic(path, data)) {
+        cerr << "Error: Unable to save tasks." << endl;
+        return;
+    }
+    for (const auto& log : obsoleteLogs) {
+        remove(log.c_str());
+    }
+}
+
+// One pending file operation for a user's task files
+struct PersistOp {
+    enum Kind {
+        APPEND_LOG, // Append data to the log at logPath
+        RESET_LOG,  // Truncate the log at logPath and write data as its header
+        SNAPSHOT,   // Rotate the log at logPath (if any) to rotatedPath, then write
+                    // data and indexData as the snapshot and index
+        COMPACT     // As SNAPSHOT, with data and indexData filled in by build
+                    // once the log is rotated
+    };
+    Kind kind;
+    string logPath;
+    string data;
+    string rotatedPath;
+    string snapshotPath;
+    string indexPath;
+    string indexData;
+    vector<string> obsoleteLogs; // SNAPSHOT, COMPACT: removed once it is written
+    function<bool(string& data, string& indexData)> build; // COMPACT
+};
+
+// Writes queued for one TaskManager, performed in order by the TaskWriter
+// thread. Log appends that arrive while earlier writes are in flight are
+// merged, so a burst of edits costs one write.
+class PersistQueue : public enable_shared_from_this<PersistQueue> {
+public:
+    PersistQueue() : scheduled(false), submitted(0), completed(0), log(nullptr) {}
+
+    ~PersistQueue() {
+        closeLog();
+    }
+
+    void append(const string& logPath, const string& record);
+    void push(PersistOp op);
+
+    // Block until everything submitted so far is on disk
+    void flush();
+
+    // Flush, then release the log file handle
+    void close() {
+        flush();
+        lock_guard<mutex> guard(lock);
+        closeLog();
+    }
+
+private:
+    friend class TaskWriter;
+
+    mutex lock;
+    condition_variable done;
+    vector<PersistOp> ops;
+    bool scheduled;      // Waiting in or being run by the writer
+    uint64_t submitted;  // Operations queued so far
+    uint64_t completed;  // Operations written so far
+    FILE* log;           // Only touched by the writer thread (or close())
+    string openLogPath;
+
+    void schedule();
+
+    // Writer side: perform the queued operations; returns how many
+    // submissions are now complete
+    uint64_t run() {
+        vector<PersistOp> batch;
+        uint64_t upTo;
+        {
+            lock_guard<mutex> guard(lock);
+            batch.swap(ops);
+            upTo = submitted;
+        }
+
+        for (auto& op : batch) {
+            switch (op.kind) {
+                case PersistOp::APPEND_LOG:
+                    if (!log || openLogPath != op.logPath) {
+                        openLog(op.logPath, "ab");
+                    }
+                    writeLog(op.data);
+                    break;
+
+                case PersistOp::RESET_LOG:
+                    openLog(op.logPath, "wb");
+                    writeLog(op.data);
+                    sync_directory(op.logPath);
+                    break;
+
+                case PersistOp::SNAPSHOT:
+                case PersistOp::COMPACT: {
+                    MetricTimer timer(METRIC_WRITE);
+                    // The rotated log must be durable before the snapshot relies on it:
+                    // its data is synced by closeLog(), its new name by syncing log/
+                    closeLog();
+                    if (!op.logPath.empty() && rename(op.logPath.c_str(), op.rotatedPath.c_str()) == 0) {
+                        sync_directory(op.rotatedPath);
+                    }
+                    // Left as it is, the rotated log is replayed at the next load
+                    if (op.kind == PersistOp::COMPACT && !op.build(op.data, op.indexData)) {
+                        cerr << "Warning: Unable to compact task log " << op.rotatedPath << "." << endl;
+                        break;
+                    }
+                    write_snapshot_file(op.snapshotPath, op.data, op.indexPath, op.indexData, op.obsoleteLogs);
+                    break;
+                }
+            }
+        }
+        // One flush and fsync covers every record in the round
+        if (log) {
+            MetricTimer timer(METRIC_SYNC);
+            if (!sync_file(log)) {
+                cerr << "Error: Unable to write task log " << openLogPath << "." << endl;
+            }
+        }
+        return upTo;
+    }
+
+    void openLog(const string& path, const char* mode) {
+        closeLog();
+        log = fopen(path.c_str(), mode);
+        openLogPath = path;
+        if (!log) {
+            cerr << "Error: Unable to open task log." << endl;
+        }
+    }
+
+    void writeLog(const string& data) {
+        if (log && fwrite(data.data(), 1, data.size(), log) != data.size()) {
+            cerr << "Error: Unable to write task log " << openLogPath << "." << endl;
+        }
+        Metrics::written(data.size());
+    }
+
+    void closeLog() {
+        if (log) {
+            sync_file(log);
+            fclose(log);
+            log = nullptr;
+        }
+    }
+};
+
+// The background thread that performs every PersistQueue's writes
+class TaskWriter {
+public:
+    static TaskWriter& instance() {
+        static TaskWriter writer;
+        return writer;
+    }
+
+    void schedule(shared_ptr<PersistQueue> queue) {
+        {
+            lock_guard<mutex> guard(lock);
+            ready.push_back(move(queue));
+        }
+        wake.notify_one();
+    }
+
+    // Skip the coalescing delay because a caller is waiting on a flush
+    void expedite() {
+        {
+            lock_guard<mutex> guard(lock);
+            urgent = true;
+        }
+        wake.notify_one();
+    }
+
+private:
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    deque<shared_ptr<PersistQueue>> ready;
+    bool stopping;
+    bool urgent;
+
+    TaskWriter() : stopping(false), urgent(false) {
+        worker = thread([this] { work(); });
+    }
+
+    // Drains the remaining queues at exit
+    ~TaskWriter() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void work() {
+        vector<shared_ptr<PersistQueue>> round;
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [this] { return stopping || !ready.empty(); });
+                if (ready.empty()) return;
+                // Give a burst of edits time to pile up, unless someone is waiting
+                wake.wait_for(guard, PERSIST_COALESCE_DELAY, [this] { return stopping || urgent; });
+                urgent = false;
+                round.assign(make_move_iterator(ready.begin()), make_move_iterator(ready.end()));
+                ready.clear();
+            }
+
+            for (auto& queue : round) {
+                uint64_t upTo = queue->run();
+
+                lock_guard<mutex> guard(queue->lock);
+                queue->completed = upTo;
+                if (queue->ops.empty()) {
+                    queue->scheduled = false;
+                } else {
+                    // More arrived while writing; go round again
+                    lock_guard<mutex> readyGuard(lock);
+                    ready.push_back(queue);
+                }
+                queue->done.notify_all();
+            }
+            round.clear();
+        }
+    }
+};
+
+void PersistQueue::append(const string& logPath, const string& record) {
+    lock_guard<mutex> guard(lock);
+    if (!ops.empty() && ops.back().kind == PersistOp::APPEND_LOG && ops.back().logPath == logPath) {
+        ops.back().data += record;
+    } else {
+        ops.push_back({PersistOp::APPEND_LOG, logPath, record, "", "", "", "", {}});
+    }
+    submitted++;
+    schedule();
+}
+
+void PersistQueue::push(PersistOp op) {
+    lock_guard<mutex> guard(lock);
+    ops.push_back(move(op));
+    submitted++;
+    schedule();
+}
+
+void PersistQueue::flush() {
+    unique_lock<mutex> guard(lock);
+    uint64_t target = submitted;
+    if (completed < target) {
+        TaskWriter::instance().expedite();
+        done.wait(guard, [&] { return completed >= target; });
+    }
+}
+
+// Called with lock held
+void PersistQueue::schedule() {
+    if (!scheduled) {
+        scheduled = true;
+        // Safe: PersistQueues are only created through make_shared
+        TaskWriter::instance().schedule(shared_from_this());
+    }
+}
+
+// Number of ranges to split work over rows rows into: one per thread for
+// very large task lists, otherwise one
+size_t parallel_chunks(size_t rows) {
+    return rows < PARALLEL_THRESHOLD ? 1 : max<size_t>(1, parallelThreads);
+}
+
+// Call fn(k, begin, end) for chunks contiguous ranges covering [0, n), range
+// 0 on the calling thread and the others on threads of their own
+template <typename Fn>
+void parallel_for(size_t chunks, size_t n, Fn fn) {
+    vector<thread> threads;
+    for (size_t k = 1; k < chunks; k++) {
+        threads.emplace_back([&fn, k, chunks, n] { fn(k, n * k / chunks, n * (k + 1) / chunks); });
+    }
+    fn(0, 0, n / chunks);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// Let fill(begin, end, part) append the results for each range of [0, n),
+// then concatenate the parts in range order, so the output does not depend
+// on the number of threads
+template <typename Fill>
+void parallel_gather(size_t chunks, size_t n, Fill fill, vector<uint32_t>& out) {
+    if (chunks <= 1) {
+        fill(0, n, out);
+        return;
+    }
+    vector<vector<uint32_t>> parts(chunks);
+    parallel_for(chunks, n, [&](size_t k, size_t begin, size_t end) {
+        fill(begin, end, parts[k]);
+    });
+    size_t total = out.size();
+    for (const auto& part : parts) total += part.size();
+    out.reserve(total);
+    for (const auto& part : parts) {
+        out.insert(out.end(), part.begin(), part.end());
+    }
+}
+
+// Sort ranges on separate threads, then merge neighbouring runs pairwise.
+// Elements must have a total order for the result to be deterministic.
+template <typename T>
+void parallel_sort(vector<T>& items) {
+    size_t chunks = parallel_chunks(items.size());
+    if (chunks <= 1) {
+        sort(items.begin(), items.end());
+        return;
+    }
+    size_t n = items.size();
+    parallel_for(chunks, n, [&items](size_t, size_t begin, size_t end) {
+        sort(items.begin() + begin, items.begin() + end);
+    });
+    for (size_t width = 1; width < chunks; width *= 2) {
+        size_t runs = (chunks + 2 * width - 1) / (2 * width);
+        parallel_for(runs, runs, [&](size_t, size_t first, size_t last) {
+            for (size_t r = first; r < last; r++) {
+                size_t k = r * 2 * width;
+                if (k + width >= chunks) continue;
+                size_t mid = n * (k + width) / chunks;
+                size_t end = n * min(k + 2 * width, chunks) / chunks;
+                inplace_merge(items.begin() + n * k / chunks, items.begin() + mid, items.begin() + end);
+            }
+        });
+    }
+}
+
+// One bit per task row
+class RowBitmap {
+public:
+    vector<uint64_t> words;
+
+    void resize(size_t rows) {
+        words.resize((rows + 63) / 64);
+        if (rows % 64 != 0) {
+            words.back() &= (uint64_t(1) << (rows % 64)) - 1;
+        }
+    }
+
+    void set(size_t row) {
+        words[row / 64] |= uint64_t(1) << (row % 64);
+    }
+
+    void reset(size_t row) {
+        words[row / 64] &= ~(uint64_t(1) << (row % 64));
+    }
+
+    // Call fn(row) for every set bit, in row order
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (size_t k = 0; k < words.size(); k++) {
+            uint64_t w = words[k];
+            while (w) {
+                fn(k * 64 + __builtin_ctzll(w));
+                w &= w - 1;
+            }
+        }
+    }
+};
+
+// Entry of the due-date index, ordered by (day, row)
+struct DueEntry {
+    int32_t day;
+    uint32_t row;
+
+    bool operator<(const DueEntry& other) const {
+        return day != other.day ? day < other.day : row < other.row;
+    }
+};
+
+// Entry of the creation-date index, ordered by (created, row)
+struct CreatedEntry {
+    int64_t created;
+    uint32_t row;
+
+    bool operator<(const CreatedEntry& other) const {
+        return created != other.created ? created < other.created : row < other.row;
+    }
+};
+
+// Call fn(term) for each word of text: a run of letters and digits, lower-cased.
+// Bytes of multi-byte UTF-8 characters count as letters.
+template <typename Fn>
+void for_each_term(string_view text, Fn fn) {
+    string term;
+    for (size_t i = 0; i <= text.size(); i++) {
+        unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        if (isalnum(c) || c >= 0x80) {
+            term.push_back(static_cast<char>(tolower(c)));
+        } else if (!term.empty()) {
+            fn(term);
+            term.clear();
+        }
+    }
+}
+
+// Inverted index from description terms to the IDs of the tasks using them.
+// The bulk of it is flat: the terms packed in order into one heap, each with
+// its run of sorted IDs in one array, so a saved index loads with a few bulk
+// reads and a prefix is a range of terms. Changes made since are kept on the
+// side as the IDs each term gained and lost, and folded in once they grow to
+// a quarter of the whole.
+class SearchIndex {
+public:
+    void add(uint64_t taskId, string_view text) {
+        for_each_term(text, [&](const string& term) { addTerm(taskId, term); });
+    }
+
+    void remove(uint64_t taskId, string_view text) {
+        for_each_term(text, [&](const string& term) { removeTerm(taskId, term); });
+    }
+
+    // Move a task from the terms of oldText to those of newText, touching
+    // only the terms that differ
+    void update(uint64_t taskId, string_view oldText, string_view newText) {
+        vector<string> before = terms(oldText), after = terms(newText);
+        vector<string> gone, added;
+        set_difference(before.begin(), before.end(), after.begin(), after.end(), back_inserter(gone));
+        set_difference(after.begin(), after.end(), before.begin(), before.end(), back_inserter(added));
+        for (const auto& term : gone) removeTerm(taskId, term);
+        for (const auto& term : added) addTerm(taskId, term);
+    }
+
+    void clear() {
+        termHeap.clear();
+        runs.clear();
+        ids.clear();
+        gained.clear();
+        lost.clear();
+        changes = 0;
+    }
+
+    // Replace the index in one pass: each(add) calls add(taskId, text) for
+    // every task. Terms are gathered in a hash map, then sorted and packed.
+    template <typename Each>
+    void rebuild(Each each) {
+        unordered_map<string, vector<uint64_t>> gathered;
+        each([&gathered](uint64_t taskId, string_view text) {
+            for_each_term(text, [&](const string& term) {
+                vector<uint64_t>& ids = gathered[term];
+                if (ids.empty() || ids.back() != taskId) ids.push_back(taskId);
+            });
+        });
+        vector<pair<string, vector<uint64_t>>> sorted;
+        sorted.reserve(gathered.size());
+        for (auto& entry : gathered) {
+            sorted.emplace_back(entry.first, move(entry.second));
+        }
+        gathered.clear();
+        sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        clear();
+        size_t heapBytes = 0, idCount = 0;
+        for (auto& entry : sorted) {
+            vector<uint64_t>& ids = entry.second;
+            if (!is_sorted(ids.begin(), ids.end())) {
+                sort(ids.begin(), ids.end());
+                ids.erase(unique(ids.begin(), ids.end()), ids.end());
+            }
+            heapBytes += entry.first.size();
+            idCount += ids.size();
+        }
+        termHeap.reserve(heapBytes);
+        runs.reserve(sorted.size());
+        ids.reserve(idCount);
+        for (const auto& entry : sorted) {
+            appendRun(entry.first, {entry.second.data(), entry.second.data() + entry.second.size()});
+        }
+    }
+
+    // IDs of the tasks whose description has every word of query, in ID
+    // order. A word ending in '*' matches every term that starts with it.
+    vector<uint64_t> search(string_view query) const {
+        vector<IdRange> lists;
+        deque<vector<uint64_t>> built; // Lists built for prefixes and changed terms
+        size_t start = 0;
+        while (start < query.size()) {
+            size_t end = query.find_first_of(" \t", start);
+            if (end == string_view::npos) end = query.size();
+            string_view word = query.substr(start, end - start);
+            start = end + 1;
+
+            vector<string> terms;
+            for_each_term(word, [&terms](const string& term) { terms.push_back(term); });
+            bool prefix = !word.empty() && word.back() == '*';
+            for (size_t k = 0; k < terms.size(); k++) {
+                built.emplace_back();
+                IdRange list;
+                if (prefix && k + 1 == terms.size()) {
+                    built.back() = prefixMatches(terms[k]);
+                    list = {built.back().data(), built.back().data() + built.back().size()};
+                } else {
+                    list = current(terms[k], baseIds(find(terms[k])), built.back());
+                }
+                if (list.size() == 0) return {};
+                lists.push_back(list);
+            }
+        }
+        if (lists.empty()) {
+            return {};
+        }
+
+        // Start from the shortest list and keep the IDs found in every other
+        // one by binary search: O(k log N) for k results, whatever the others' size
+        sort(lists.begin(), lists.end(), [](const IdRange& a, const IdRange& b) {
+            return a.size() < b.size();
+        });
+        vector<uint64_t> result(lists[0].begin, lists[0].end);
+        for (size_t k = 1; k < lists.size() && !result.empty(); k++) {
+            const IdRange& other = lists[k];
+            result.erase(remove_if(result.begin(), result.end(), [&other](uint64_t taskId) {
+                return !binary_search(other.begin, other.end, taskId);
+            }), result.end());
+        }
+        return result;
+    }
+
+    size_t memoryUsage() const {
+        size_t bytes = termHeap.capacity() + runs.capacity() * sizeof(TermRun) + ids.capacity() * sizeof(uint64_t);
+        // Tree nodes hold the term and list headers plus about four pointers
+        size_t inlineCapacity = string().capacity();
+        for (const auto* side : {&gained, &lost}) {
+            bytes += side->size() * (sizeof(pair<const string, vector<uint64_t>>) + 4 * sizeof(void*));
+            for (const auto& entry : *side) {
+                if (entry.first.capacity() > inlineCapacity) bytes += entry.first.capacity() + 1;
+                bytes += entry.second.capacity() * sizeof(uint64_t);
+            }
+        }
+        return bytes;
+    }
+
+    // Term count, term heap size and ID count, then the term heap, per term
+    // its offset and length in the heap and the position of its first ID,
+    // and the IDs. Changes are folded in first.
+    void encode(string& out) const {
+        if (!gained.empty() || !lost.empty()) {
+            folded().encode(out);
+            return;
+        }
+        put_u64(out, runs.size());
+        put_u64(out, termHeap.size());
+        put_u64(out, ids.size());
+        out += termHeap;
+        for (const auto& run : runs) {
+            put_u32(out, run.offset);
+            put_u32(out, run.length);
+            put_u64(out, run.first);
+        }
+        for (uint64_t taskId : ids) {
+            put_u64(out, taskId);
+        }
+    }
+
+    bool decode(ByteReader& in) {
+        clear();
+        uint64_t termCount = in.u64();
+        uint64_t heapBytes = in.u64();
+        uint64_t idCount = in.u64();
+        size_t left = in.ok ? static_cast<size_t>(in.end - in.p) : 0;
+        if (heapBytes > left || termCount > (left - heapBytes) / 16 ||
+            idCount > (left - heapBytes - termCount * 16) / 8) {
+            in.ok = false;
+            return false;
+        }
+
+        termHeap.assign(in.p, heapBytes);
+        in.p += heapBytes;
+        runs.resize(termCount);
+        uint64_t previous = 0;
+        for (auto& run : runs) {
+            run.offset = in.u32();
+            run.length = in.u32();
+            run.first = in.u64();
+            if (static_cast<uint64_t>(run.offset) + run.length > heapBytes || run.first < previous || run.first > idCount) {
+                in.ok = false;
+            }
+            previous = run.first;
+        }
+        ids.resize(idCount);
+        for (auto& taskId : ids) {
+            taskId = in.u64();
+        }
+        if (!in.ok) clear();
+        return in.ok;
+    }
+
+private:
+    // A term in termHeap and the start of its IDs in ids; they run up to the
+    // next term's
+    struct TermRun {
+        uint32_t offset;
+        uint32_t length;
+        uint64_t first;
+    };
+
+    struct IdRange {
+        const uint64_t* begin = nullptr;
+        const uint64_t* end = nullptr;
+
+        size_t size() const {
+            return end - begin;
+        }
+    };
+
+    static constexpr size_t FOLD_MIN = 4096; // Changes always kept on the side
+
+    string termHeap;
+    vector<TermRun> runs; // In term order
+    vector<uint64_t> ids;
+    map<string, vector<uint64_t>, less<>> gained; // IDs not in the term's run
+    map<string, vector<uint64_t>, less<>> lost;   // IDs in the run that no longer count
+    size_t changes = 0;                           // Since the flat part was built
+
+    string_view termAt(size_t k) const {
+        return string_view(termHeap).substr(runs[k].offset, runs[k].length);
+    }
+
+    // First run whose term is not less than term
+    size_t lowerBound(string_view term) const {
+        size_t lo = 0, hi = runs.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (termAt(mid) < term) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Run of term, or runs.size() if it has none
+    size_t find(string_view term) const {
+        size_t k = lowerBound(term);
+        return k < runs.size() && termAt(k) == term ? k : runs.size();
+    }
+
+    IdRange baseIds(size_t k) const {
+        if (k >= runs.size()) return {};
+        size_t end = k + 1 < runs.size() ? runs[k + 1].first : ids.size();
+        return {ids.data() + runs[k].first, ids.data() + end};
+    }
+
+    // IDs of term now: its run less what it lost plus what it gained, built
+    // in scratch when there are changes
+    IdRange current(string_view term, IdRange base, vector<uint64_t>& scratch) const {
+        auto plus = gained.empty() ? gained.end() : gained.find(term);
+        auto minus = lost.empty() ? lost.end() : lost.find(term);
+        if (plus == gained.end() && minus == lost.end()) return base;
+
+        scratch.clear();
+        if (minus == lost.end()) {
+            scratch.assign(base.begin, base.end);
+        } else {
+            set_difference(base.begin, base.end, minus->second.begin(), minus->second.end(), back_inserter(scratch));
+        }
+        if (plus != gained.end()) {
+            size_t middle = scratch.size();
+            scratch.insert(scratch.end(), plus->second.begin(), plus->second.end());
+            inplace_merge(scratch.begin(), scratch.begin() + middle, scratch.end());
+        }
+        return {scratch.data(), scratch.data() + scratch.size()};
+    }
+
+    void appendRun(string_view term, IdRange list) {
+        runs.push_back({static_cast<uint32_t>(termHeap.size()), static_cast<uint32_t>(term.size()), ids.size()});
+        termHeap.append(term);
+        ids.insert(ids.end(), list.begin, list.end);
+    }
+
+    // The index as one flat part, changes merged in
+    SearchIndex folded() const {
+        SearchIndex result;
+        result.termHeap.reserve(termHeap.size());
+        result.runs.reserve(runs.size());
+        result.ids.reserve(ids.size());
+        vector<uint64_t> scratch;
+        size_t k = 0;
+        auto extra = gained.begin();
+        while (k < runs.size() || extra != gained.end()) {
+            IdRange list;
+            string_view term;
+            if (extra == gained.end() || (k < runs.size() && termAt(k) <= extra->first)) {
+                term = termAt(k);
+                list = current(term, baseIds(k), scratch);
+                if (extra != gained.end() && term == extra->first) ++extra;
+                k++;
+            } else {
+                term = extra->first;
+                list = current(term, {}, scratch);
+                ++extra;
+            }
+            if (list.size() > 0) result.appendRun(term, list);
+        }
+        return result;
+    }
+
+    // Fold the changes in once they are a sizeable part of the index, so
+    // lookups stay cheap and the cost is spread over the changes made
+    void noteChange() {
+        if (++changes > max(FOLD_MIN, ids.size() / 4)) {
+            *this = folded();
+        }
+    }
+
+    static bool contains(IdRange list, uint64_t taskId) {
+        return binary_search(list.begin, list.end, taskId);
+    }
+
+    static void insertId(vector<uint64_t>& list, uint64_t taskId) {
+        auto it = lower_bound(list.begin(), list.end(), taskId);
+        if (it == list.end() || *it != taskId) list.insert(it, taskId);
+    }
+
+    // Drop taskId from the side list of term, and the list once empty
+    static void eraseId(map<string, vector<uint64_t>, less<>>& side, const string& term, uint64_t taskId) {
+        auto found = side.find(term);
+        if (found == side.end()) return;
+        vector<uint64_t>& list = found->second;
+        auto it = lower_bound(list.begin(), list.end(), taskId);
+        if (it != list.end() && *it == taskId) list.erase(it);
+        if (list.empty()) side.erase(found);
+    }
+
+    void addTerm(uint64_t taskId, const string& term) {
+        if (contains(baseIds(find(term)), taskId)) {
+            eraseId(lost, term, taskId);
+        } else {
+            insertId(gained[term], taskId);
+        }
+        noteChange();
+    }
+
+    void removeTerm(uint64_t taskId, const string& term) {
+        if (contains(baseIds(find(term)), taskId)) {
+            insertId(lost[term], taskId);
+        } else {
+            eraseId(gained, term, taskId);
+        }
+        noteChange();
+    }
+
+    // Distinct terms of text, sorted
+    static vector<string> terms(string_view text) {
+        vector<string> found;
+        for_each_term(text, [&found](const string& term) { found.push_back(term); });
+        sort(found.begin(), found.end());
+        found.erase(unique(found.begin(), found.end()), found.end());
+        return found;
+    }
+
+    // Merged IDs of every term starting with prefix
+    vector<uint64_t> prefixMatches(const string& term) const {
+        vector<uint64_t> found, scratch;
+        for (size_t k = lowerBound(term); k < runs.size() && termAt(k).compare(0, term.size(), term) == 0; k++) {
+            IdRange list = current(termAt(k), baseIds(k), scratch);
+            found.insert(found.end(), list.begin, list.end);
+        }
+        // Terms the flat part does not have yet
+        for (auto it = gained.lower_bound(term);
+             it != gained.end() && it->first.compare(0, term.size(), term) == 0; ++it) {
+            if (find(it->first) == runs.size()) {
+                found.insert(found.end(), it->second.begin(), it->second.end());
+            }
+        }
+        sort(found.begin(), found.end());
+        found.erase(unique(found.begin(), found.end()), found.end());
+        return found;
+    }
+};
+
+// Location of a task's description in a TaskStore's text heap
+struct TextSpan {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Column-oriented task storage.
+// Each field scans look at (priority, status, due day, timestamps) lives in its
+// own dense array, and descriptions are kept apart, so counting and filtering
+// never drag description text through the cache. Rows are materialized as
+// Task values only where a whole task is needed.
+//
+// Descriptions are packed back to back in one text heap, and each row holds
+// an (offset, length) span into it, so loading is bump allocation (a snapshot's
+// heap is copied in whole) and releasing the store frees a handful of blocks.
+// Edited and deleted text stays in the heap as garbage until compact().
+//
+// The store also maintains secondary indexes, updated on every mutation:
+// a bitmap of rows per status and per priority, the rows that have a due
+// date ordered by (day, row) for range queries, and every row ordered by
+// creation time. Together they give each TaskOrder without sorting. A search
+// index maps description terms to task IDs, which compaction does not change.
+//
+// Every task has a stable 64-bit ID that survives sorts, deletes and restarts;
+// a hash map finds its row in O(1). A delete only marks the row deleted
+// (STATUS_DELETED, dropped from the indexes) instead of shifting every later
+// row, and compact() squeezes deleted rows out once they outnumber live ones.
+class TaskStore {
+public:
+    vector<uint64_t> id;
+    vector<uint8_t> priority;
+    vector<uint8_t> status;
+    vector<int32_t> dueDay; // DUE_NONE when there is no due date
+    vector<int64_t> createdDate;
+    vector<int64_t> completedDate;
+    vector<TextSpan> descriptionSpan; // Into textHeap
+    string textHeap;                  // Every description, back to back
+
+    RowBitmap byStatus[3];   // Indexed by TaskStatus
+    RowBitmap byPriority[4]; // Indexed by Priority (LOW..HIGH)
+    vector<DueEntry> byDue;  // Rows with a due date, sorted
+    vector<CreatedEntry> byCreated; // Every row, sorted
+    SearchIndex byTerm;      // Task IDs per description term
+    uint64_t nextId;         // ID given to the next new task
+
+    TaskStore() : nextId(1), totals(), overdueDay(0), deleted(0), textGarbage(0), indexed(true) {}
+
+    // Rows, including deleted rows not yet compacted away
+    size_t size() const {
+        return priority.size();
+    }
+
+    // Tasks that have not been deleted
+    size_t count() const {
+        return priority.size() - deleted;
+    }
+
+    bool empty() const {
+        return count() == 0;
+    }
+
+    bool live(size_t i) const {
+        return status[i] != STATUS_DELETED;
+    }
+
+    string_view description(size_t i) const {
+        return string_view(textHeap.data() + descriptionSpan[i].offset, descriptionSpan[i].length);
+    }
+
+    // Empty and indexed again, whatever a suspended bulk change left behind
+    void clear() {
+        indexed = true;
+        resize(0);
+        rows.clear();
+        textHeap.clear();
+        deleted = 0;
+        textGarbage = 0;
+        nextId = 1;
+        totals = {};
+        overdueDay = 0;
+    }
+
+    // Row holding the task with this ID
+    bool find(uint64_t taskId, size_t& row) const {
+        auto it = rows.find(taskId);
+        if (it == rows.end()) {
+            return false;
+        }
+        row = it->second;
+        return true;
+    }
+
+    // Approximate heap bytes held by the columns, descriptions and indexes
+    size_t memoryUsage() const {
+        size_t bytes = id.capacity() * sizeof(uint64_t)
+                     + priority.capacity() + status.capacity()
+                     + dueDay.capacity() * sizeof(int32_t)
+                     + (createdDate.capacity() + completedDate.capacity()) * sizeof(int64_t)
+                     + descriptionSpan.capacity() * sizeof(TextSpan) + textHeap.capacity()
+                     + byDue.capacity() * sizeof(DueEntry)
+                     + byCreated.capacity() * sizeof(CreatedEntry)
+                     + rows.bucket_count() * sizeof(void*)
+                     + rows.size() * (sizeof(pair<const uint64_t, uint32_t>) + sizeof(void*))
+                     + byTerm.memoryUsage();
+        for (const auto& bitmap : byStatus) bytes += bitmap.words.capacity() * sizeof(uint64_t);
+        for (const auto& bitmap : byPriority) bytes += bitmap.words.capacity() * sizeof(uint64_t);
+        return bytes;
+    }
+
+    // Resize the columns; the indexes must be rebuilt or loaded afterwards
+    void resize(size_t n) {
+        id.resize(n);
+        priority.resize(n);
+        status.resize(n);
+        dueDay.resize(n);
+        createdDate.resize(n);
+        completedDate.resize(n);
+        descriptionSpan.resize(n);
+        if (!indexed) return;
+        for (auto& bitmap : byStatus) bitmap.resize(n);
+        for (auto& bitmap : byPriority) bitmap.resize(n);
+        if (n == 0) {
+            byDue.clear();
+            byCreated.clear();
+            byTerm.clear();
+        }
+    }
+
+    // Stop maintaining the indexes during a bulk change; rebuildIndexes() resumes
+    void suspendIndexes() {
+        indexed = false;
+        for (auto& bitmap : byStatus) vector<uint64_t>().swap(bitmap.words);
+        for (auto& bitmap : byPriority) vector<uint64_t>().swap(bitmap.words);
+        vector<DueEntry>().swap(byDue);
+        vector<CreatedEntry>().swap(byCreated);
+        byTerm.clear();
+    }
+
+    // Add a task, keeping its ID if it has one; returns the ID
+    uint64_t push_back(const Task& task) {
+        resize(size() + 1);
+        uint64_t taskId = assignId(size() - 1, task.id);
+        set(size() - 1, task, false);
+        return taskId;
+    }
+
+    // Add a row without indexing it, for bulk loads; call rebuildIndexes() after
+    uint64_t append(const Task& task) {
+        id.push_back(0);
+        priority.push_back(static_cast<uint8_t>(task.priority));
+        status.push_back(static_cast<uint8_t>(task.status));
+        dueDay.push_back(task.dueDay);
+        createdDate.push_back(task.createdDate);
+        completedDate.push_back(task.completedDate);
+        descriptionSpan.push_back({0, 0});
+        storeText(size() - 1, task.description);
+        return assignId(size() - 1, task.id);
+    }
+
+    Task get(size_t i) const {
+        Task task;
+        task.id = id[i];
+        task.description.assign(description(i));
+        task.dueDay = dueDay[i];
+        task.priority = static_cast<Priority>(priority[i]);
+        task.status = static_cast<TaskStatus>(status[i]);
+        task.createdDate = static_cast<time_t>(createdDate[i]);
+        task.completedDate = static_cast<time_t>(completedDate[i]);
+        return task;
+    }
+
+    void set(size_t i, const Task& task) {
+        set(i, task, true);
+    }
+
+    // Delete the task in row i; other tasks keep their rows until the next
+    // compaction, which runs once deleted rows outnumber live ones
+    void erase(size_t i) {
+        unindex(i);
+        rows.erase(id[i]);
+        status[i] = STATUS_DELETED;
+        priority[i] = 0;
+        dueDay[i] = DUE_NONE;
+        textGarbage += descriptionSpan[i].length;
+        descriptionSpan[i] = {0, 0};
+        deleted++;
+        if (deleted > count() && deleted >= COMPACT_MIN_DELETED) {
+            compact();
+        }
+    }
+
+    // Drop deleted rows, keeping the order of the others, and repack the text
+    void compact() {
+        if (textGarbage > 0) compactText();
+        if (deleted == 0) return;
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); i++) {
+            if (!live(i)) continue;
+            if (kept != i) {
+                id[kept] = id[i];
+                priority[kept] = priority[i];
+                status[kept] = status[i];
+                dueDay[kept] = dueDay[i];
+                createdDate[kept] = createdDate[i];
+                completedDate[kept] = completedDate[i];
+                descriptionSpan[kept] = descriptionSpan[i];
+                rows[id[kept]] = static_cast<uint32_t>(kept);
+            }
+            kept++;
+        }
+        resize(kept);
+        deleted = 0;
+        if (indexed) rebuildRowIndexes();
+    }
+
+    // Take over a snapshot's text heap after the spans were filled in directly
+    void loadText(const char* heap, size_t heapSize) {
+        textHeap.assign(heap, heapSize);
+        textGarbage = heapSize;
+        for (const auto& span : descriptionSpan) textGarbage -= span.length;
+    }
+
+    // Recompute the ID map after the id column was filled in directly
+    void rebuildIds() {
+        rows.clear();
+        rows.reserve(size());
+        for (size_t i = 0; i < size(); i++) {
+            rows[id[i]] = static_cast<uint32_t>(i);
+            nextId = max(nextId, id[i] + 1);
+        }
+    }
+
+    // Recompute every index from the columns
+    void rebuildIndexes() {
+        rebuildRowIndexes();
+        byTerm.rebuild([this](auto add) {
+            for (size_t i = 0; i < size(); i++) {
+                if (live(i)) add(id[i], description(i));
+            }
+        });
+    }
+
+    // Status, priority and overdue counts of the live tasks, kept up to date
+    // on every change. The overdue count is held for overdueDay; only the
+    // tasks due between it and today are looked at, O(log N) plus those.
+    TaskCounts counts(int32_t today) const {
+        if (!indexed) {
+            return count_tasks(status.data(), priority.data(), dueDay.data(), size(), today);
+        }
+        TaskCounts result = totals;
+        result.overdue += overdueShift(overdueDay, today);
+        return result;
+    }
+
+    // Move the overdue count to today, so later counts() look at fewer tasks
+    void advanceOverdue(int32_t today) {
+        if (!indexed) return;
+        totals.overdue += overdueShift(overdueDay, today);
+        overdueDay = today;
+    }
+
+    // Task IDs whose description matches query; see SearchIndex::search()
+    vector<uint64_t> search(string_view query) const {
+        return byTerm.search(query);
+    }
+
+    // Live rows in the given order, read off the indexes: O(N), no sorting.
+    // Ties keep list order.
+    void orderedRows(TaskOrder order, vector<uint32_t>& rows) const {
+        MetricTimer timer(METRIC_SORT);
+        rows.reserve(rows.size() + count());
+        auto add = [&rows](size_t row) { rows.push_back(static_cast<uint32_t>(row)); };
+        switch (order) {
+            case ORDER_DUE:
+                for (const auto& entry : byDue) rows.push_back(entry.row);
+                parallel_gather(parallel_chunks(size()), size(), [this](size_t begin, size_t end, vector<uint32_t>& part) {
+                    for (size_t i = begin; i < end; i++) {
+                        if (live(i) && dueDay[i] == DUE_NONE) part.push_back(static_cast<uint32_t>(i));
+                    }
+                }, rows);
+                break;
+            case ORDER_PRIORITY:
+                for (int p = HIGH; p >= LOW; p--) byPriority[p].for_each(add);
+                break;
+            case ORDER_STATUS:
+                for (int st = PENDING; st <= COMPLETED; st++) byStatus[st].for_each(add);
+                break;
+            case ORDER_CREATED:
+                for (auto it = byCreated.rbegin(); it != byCreated.rend(); ++it) rows.push_back(it->row);
+                break;
+            default:
+                parallel_gather(parallel_chunks(size()), size(), [this](size_t begin, size_t end, vector<uint32_t>& part) {
+                    for (size_t i = begin; i < end; i++) {
+                        if (live(i)) part.push_back(static_cast<uint32_t>(i));
+                    }
+                }, rows);
+                break;
+        }
+    }
+
+    // Sort some of the rows into the given order, the same one orderedRows()
+    // produces: O(K log K) for K rows, without walking the whole list
+    void sortRows(TaskOrder order, vector<uint32_t>& rows) const {
+        switch (order) {
+            case ORDER_DUE:
+                // No due date is DUE_NONE, the largest day, so those come last
+                sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+                    return dueDay[a] != dueDay[b] ? dueDay[a] < dueDay[b] : a < b;
+                });
+                break;
+            case ORDER_PRIORITY:
+                sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+                    return priority[a] != priority[b] ? priority[a] > priority[b] : a < b;
+                });
+                break;
+            case ORDER_STATUS:
+                sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+                    return status[a] != status[b] ? status[a] < status[b] : a < b;
+                });
+                break;
+            case ORDER_CREATED:
+                // byCreated read backwards: ties on the time are newest row first
+                sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+                    return createdDate[a] != createdDate[b] ? createdDate[a] > createdDate[b] : a > b;
+                });
+                break;
+            default:
+                sort(rows.begin(), rows.end());
+                break;
+        }
+    }
+
+    // Positions in byDue of the rows due in [first, last]: O(log N)
+    pair<size_t, size_t> dueRange(int32_t first, int32_t last) const {
+        auto begin = lower_bound(byDue.begin(), byDue.end(), DueEntry{first, 0});
+        auto end = upper_bound(begin, byDue.end(), DueEntry{last, UINT32_MAX});
+        return {static_cast<size_t>(begin - byDue.begin()), static_cast<size_t>(end - byDue.begin())};
+    }
+
+    // Index file layout (little-endian):
+    //   header  "TDLI", version, generation, row count, due entry count, CRC-32
+    //   body    counts (overdue day, 3 status, 3 priority, overdue),
+    //           status bitmaps, priority bitmaps, due entries (day, row),
+    //           created entries (time, row), one per row, search index
+    string encodeIndexes(uint64_t gen) const {
+        string body;
+        put_u32(body, static_cast<uint32_t>(overdueDay));
+        for (int st = PENDING; st <= COMPLETED; st++) put_u64(body, totals.byStatus[st]);
+        for (int p = LOW; p <= HIGH; p++) put_u64(body, totals.byPriority[p]);
+        put_u64(body, totals.overdue);
+        for (const auto& bitmap : byStatus) {
+            for (uint64_t w : bitmap.words) put_u64(body, w);
+        }
+        for (int p = LOW; p <= HIGH; p++) {
+            for (uint64_t w : byPriority[p].words) put_u64(body, w);
+        }
+        for (const auto& entry : byDue) {
+            put_u32(body, static_cast<uint32_t>(entry.day));
+            put_u32(body, entry.row);
+        }
+        for (const auto& entry : byCreated) {
+            put_u64(body, static_cast<uint64_t>(entry.created));
+            put_u32(body, entry.row);
+        }
+        byTerm.encode(body);
+
+        string data = "TDLI";
+        put_u32(data, INDEX_VERSION);
+        put_u64(data, gen);
+        put_u64(data, size());
+        put_u64(data, byDue.size());
+        put_u32(data, crc32(body.data(), body.size()));
+        data += body;
+        return data;
+    }
+
+    // Load indexes saved for generation gen over the current columns
+    bool loadIndexes(const MappedFile& file, uint64_t gen) {
+        ByteReader in(file.data, file.size);
+        if (!in.has(36) || memcmp(file.data, "TDLI", 4) != 0) {
+            return false;
+        }
+        in.p += 4;
+        if (in.u32() != INDEX_VERSION || in.u64() != gen || in.u64() != size()) {
+            return false;
+        }
+        uint64_t dueCount = in.u64();
+        uint32_t checksum = in.u32();
+        size_t words = (size() + 63) / 64;
+        if (static_cast<size_t>(in.end - in.p) < 60 + words * 6 * 8 + dueCount * 8 + size() * 12 ||
+            crc32(in.p, in.end - in.p) != checksum) {
+            return false;
+        }
+
+        overdueDay = static_cast<int32_t>(in.u32());
+        totals = {};
+        for (int st = PENDING; st <= COMPLETED; st++) totals.byStatus[st] = in.u64();
+        for (int p = LOW; p <= HIGH; p++) totals.byPriority[p] = in.u64();
+        totals.overdue = in.u64();
+
+        for (auto& bitmap : byStatus) {
+            for (auto& w : bitmap.words) w = in.u64();
+        }
+        byPriority[0].words.assign(words, 0);
+        for (int p = LOW; p <= HIGH; p++) {
+            for (auto& w : byPriority[p].words) w = in.u64();
+        }
+        byDue.resize(dueCount);
+        for (auto& entry : byDue) {
+            entry.day = static_cast<int32_t>(in.u32());
+            entry.row = in.u32();
+        }
+        byCreated.resize(size());
+        for (auto& entry : byCreated) {
+            entry.created = static_cast<int64_t>(in.u64());
+            entry.row = in.u32();
+        }
+        return byTerm.decode(in) && in.p == in.end;
+    }
+
+private:
+    TaskCounts totals;                      // Live tasks; overdue as of overdueDay
+    int32_t overdueDay;
+    unordered_map<uint64_t, uint32_t> rows; // Task ID to row
+    size_t deleted;                         // Deleted rows not yet compacted
+    size_t textGarbage;                     // Heap bytes no span points to
+    bool indexed;
+
+    // Point row i at a copy of text appended to the heap
+    void storeText(size_t i, const string& text) {
+        if (textHeap.size() + text.size() > UINT32_MAX) compactText();
+        textGarbage += descriptionSpan[i].length;
+        descriptionSpan[i] = {static_cast<uint32_t>(textHeap.size()), static_cast<uint32_t>(text.size())};
+        textHeap += text;
+    }
+
+    // Rewrite the heap with only the live text, in row order
+    void compactText() {
+        string packed;
+        packed.reserve(textHeap.size() - textGarbage);
+        for (auto& span : descriptionSpan) {
+            packed.append(textHeap, span.offset, span.length);
+            span.offset = static_cast<uint32_t>(packed.size() - span.length);
+        }
+        textHeap.swap(packed);
+        textGarbage = 0;
+    }
+
+    // Recompute the indexes that refer to rows, and the counts
+    void rebuildRowIndexes() {
+        indexed = true;
+        for (auto& bitmap : byStatus) bitmap.words.assign((size() + 63) / 64, 0);
+        for (auto& bitmap : byPriority) bitmap.words.assign((size() + 63) / 64, 0);
+        byDue.clear();
+        byCreated.clear();
+        totals = {};
+        for (size_t i = 0; i < size(); i++) {
+            if (!live(i)) continue;
+            tally(i, 1);
+            byStatus[status[i] % 3].set(i);
+            byPriority[priority[i] & 3].set(i);
+            if (dueDay[i] != DUE_NONE) {
+                byDue.push_back({dueDay[i], static_cast<uint32_t>(i)});
+            }
+            byCreated.push_back({createdDate[i], static_cast<uint32_t>(i)});
+        }
+        parallel_sort(byDue);
+        parallel_sort(byCreated);
+    }
+
+    // Add row i to the counts (delta 1) or take it out (delta -1)
+    void tally(size_t i, int delta) {
+        size_t step = static_cast<size_t>(delta);
+        totals.byStatus[status[i] % 3] += step;
+        totals.byPriority[priority[i] & 3] += step;
+        if (dueDay[i] < overdueDay && status[i] != COMPLETED) totals.overdue += step;
+    }
+
+    // Change in the overdue count when its day moves from one day to another:
+    // the open tasks due in between, O(log N) to find them
+    size_t overdueShift(int32_t from, int32_t to) const {
+        if (from == to) return 0;
+        auto range = dueRange(min(from, to), max(from, to) - 1);
+        size_t open = 0;
+        for (size_t k = range.first; k < range.second; k++) {
+            open += status[byDue[k].row] != COMPLETED;
+        }
+        return from < to ? open : 0 - open;
+    }
+
+    // Give row i the task ID taskId, or a new one if it is 0
+    uint64_t assignId(size_t i, uint64_t taskId) {
+        if (taskId == 0) taskId = nextId;
+        nextId = max(nextId, taskId + 1);
+        id[i] = taskId;
+        rows[taskId] = static_cast<uint32_t>(i);
+        return taskId;
+    }
+
+    // The sorted indexes are binary searched; an edit only touches the ones
+    // whose key changed
+    void set(size_t i, const Task& task, bool replacing) {
+        bool dueMoved = !replacing || dueDay[i] != task.dueDay;
+        bool createdMoved = !replacing || createdDate[i] != task.createdDate;
+        bool textChanged = !replacing || description(i) != task.description;
+        if (replacing) unindex(i, dueMoved, createdMoved, false);
+        if (textChanged) {
+            if (indexed && replacing) {
+                byTerm.update(id[i], description(i), task.description);
+            } else if (indexed) {
+                byTerm.add(id[i], task.description);
+            }
+            storeText(i, task.description);
+        }
+        dueDay[i] = task.dueDay;
+        priority[i] = static_cast<uint8_t>(task.priority);
+        status[i] = static_cast<uint8_t>(task.status);
+        createdDate[i] = task.createdDate;
+        completedDate[i] = task.completedDate;
+        if (!indexed) return;
+
+        tally(i, 1);
+        byStatus[status[i] % 3].set(i);
+        byPriority[priority[i] & 3].set(i);
+        if (dueMoved && dueDay[i] != DUE_NONE) {
+            DueEntry entry = {dueDay[i], static_cast<uint32_t>(i)};
+            byDue.insert(upper_bound(byDue.begin(), byDue.end(), entry), entry);
+        }
+        if (createdMoved) {
+            // New tasks are the newest, so this is normally an append
+            CreatedEntry entry = {createdDate[i], static_cast<uint32_t>(i)};
+            byCreated.insert(upper_bound(byCreated.begin(), byCreated.end(), entry), entry);
+        }
+    }
+
+    void unindex(size_t i, bool due = true, bool created = true, bool text = true) {
+        if (!indexed) return;
+        if (text) byTerm.remove(id[i], description(i));
+        tally(i, -1);
+        byStatus[status[i] % 3].reset(i);
+        byPriority[priority[i] & 3].reset(i);
+        if (due && dueDay[i] != DUE_NONE) {
+            DueEntry entry = {dueDay[i], static_cast<uint32_t>(i)};
+            auto it = lower_bound(byDue.begin(), byDue.end(), entry);
+            if (it != byDue.end() && it->row == entry.row) {
+                byDue.erase(it);
+            }
+        }
+        if (created) {
+            CreatedEntry entry = {createdDate[i], static_cast<uint32_t>(i)};
+            auto it = lower_bound(byCreated.begin(), byCreated.end(), entry);
+            if (it != byCreated.end() && it->row == entry.row) {
+                byCreated.erase(it);
+            }
+        }
+    }
+};
+
+// Rows of a TaskStore selected by a query, in task order.
+// Only row numbers are held; task data is read from the store when printed.
+struct TaskView {
+    const TaskStore* store;
+    vector<uint32_t> rows;
+
+    size_t size() const {
+        return rows.size();
+    }
+
+    bool empty() const {
+        return rows.empty();
+    }
+};
+
+// Composable filter over a TaskStore; all conditions must hold.
+// run() starts from the due-date index when a date range is given and from
+// the status/priority bitmaps otherwise, then checks the remaining conditions
+// against the narrow columns. Very large scans are split across threads.
+class TaskQuery {
+public:
+    TaskQuery() : statusMask(ALL_STATUSES), priorityMask(ALL_PRIORITIES),
+                  dueFirst(INT32_MIN), dueLast(INT32_MAX), hasDueRange(false) {}
+
+    TaskQuery& withStatus(TaskStatus status) {
+        statusMask &= 1u << status;
+        return *this;
+    }
+
+    TaskQuery& withoutStatus(TaskStatus status) {
+        statusMask &= ~(1u << status);
+        return *this;
+    }
+
+    TaskQuery& withPriority(Priority priority) {
+        priorityMask &= 1u << priority;
+        return *this;
+    }
+
+    // Only tasks with a due date in [first, last]
+    TaskQuery& dueBetween(int32_t first, int32_t last) {
+        dueFirst = max(dueFirst, first);
+        dueLast = min(dueLast, last);
+        hasDueRange = true;
+        return *this;
+    }
+
+    static TaskQuery dueToday(int32_t today) {
+        return TaskQuery().dueBetween(today, today);
+    }
+
+    static TaskQuery dueThisWeek(int32_t today) {
+        return TaskQuery().dueBetween(today, today + 7);
+    }
+
+    static TaskQuery overdue(int32_t today) {
+        return TaskQuery().dueBetween(INT32_MIN, today - 1).withoutStatus(COMPLETED);
+    }
+
+    TaskView run(const TaskStore& store) const {
+        TaskView view = {&store, {}};
+        if (hasDueRange) {
+            if (dueFirst > dueLast) {
+                return view;
+            }
+            auto range = store.dueRange(dueFirst, dueLast);
+            size_t matches = range.second - range.first;
+            parallel_gather(parallel_chunks(matches), matches, [&](size_t begin, size_t end, vector<uint32_t>& part) {
+                for (size_t i = range.first + begin; i < range.first + end; i++) {
+                    uint32_t row = store.byDue[i].row;
+                    if (matchesMasks(store, row)) part.push_back(row);
+                }
+            }, view.rows);
+            parallel_sort(view.rows);
+            return view;
+        }
+
+        // Combine the bitmaps word by word: (any allowed status) AND (any allowed priority)
+        size_t words = (store.size() + 63) / 64;
+        parallel_gather(parallel_chunks(store.size()), words, [&](size_t first, size_t last, vector<uint32_t>& part) {
+            for (size_t k = first; k < last; k++) {
+                uint64_t statusBits = 0, priorityBits = 0;
+                for (int st = PENDING; st <= COMPLETED; st++) {
+                    if (statusMask & (1u << st)) statusBits |= store.byStatus[st].words[k];
+                }
+                for (int pr = LOW; pr <= HIGH; pr++) {
+                    if (priorityMask & (1u << pr)) priorityBits |= store.byPriority[pr].words[k];
+                }
+                uint64_t w = statusBits & priorityBits;
+                while (w) {
+                    part.push_back(static_cast<uint32_t>(k * 64 + __builtin_ctzll(w)));
+                    w &= w - 1;
+                }
+            }
+        }, view.rows);
+        return view;
+    }
+
+private:
+    static const unsigned ALL_STATUSES = (1u << PENDING) | (1u << IN_PROGRESS) | (1u << COMPLETED);
+    static const unsigned ALL_PRIORITIES = (1u << LOW) | (1u << MEDIUM) | (1u << HIGH);
+
+    unsigned statusMask;
+    unsigned priorityMask;
+    int32_t dueFirst;
+    int32_t dueLast;
+    bool hasDueRange;
+
+    bool matchesMasks(const TaskStore& store, uint32_t row) const {
+        return (statusMask & (1u << store.status[row])) && (priorityMask & (1u << store.priority[row]));
+    }
+};
+
+// Fixed-width task table of the task screens. A page of rows is formatted
+// into one buffer and written with a single call, and rows outside the page
+// are never formatted.
+class TaskTable {
+public:
+    TaskTable(const TaskStore& taskStore, bool withCreated) : store(taskStore), showCreated(withCreated) {}
+
+    // Header plus rows[offset, offset + limit)
+    void render(const vector<uint32_t>& rows, size_t offset, size_t limit, ostream& out) const {
+        size_t end = min(rows.size(), offset + limit);
+        // IDs are never reused, so widen the ID column once they outgrow it
+        size_t idWidth = 5;
+        for (size_t k = offset; k < end; k++) {
+            idWidth = max(idWidth, to_string(store.id[rows[k]]).size() + 1);
+        }
+
+        string buffer;
+        cell(buffer, "ID", idWidth);
+        cell(buffer, "Description", 30);
+        cell(buffer, "Due Date", 12);
+        cell(buffer, "Priority", 10);
+        cell(buffer, "Status", 15);
+        if (showCreated) cell(buffer, "Created", 12);
+        buffer += '\n';
+        buffer.append((showCreated ? 79 : 67) + idWidth, '-');
+        buffer += '\n';
+
+        for (size_t k = offset; k < end; k++) {
+            size_t row = rows[k];
+            string_view description = store.description(row);
+            cell(buffer, to_string(store.id[row]), idWidth);
+            if (description.length() > 27) {
+                cell(buffer, string(description.substr(0, 27)) + "...", 30);
+            } else {
+                cell(buffer, description, 30);
+            }
+            cell(buffer, store.dueDay[row] == DUE_NONE ? "None" : day_to_date(store.dueDay[row]), 12);
+            cell(buffer, priority_string(static_cast<Priority>(store.priority[row])), 10);
+            cell(buffer, status_string(static_cast<TaskStatus>(store.status[row])), 15);
+            if (showCreated) cell(buffer, format_timestamp(store.createdDate[row]), 12);
+            buffer += '\n';
+        }
+        out.write(buffer.data(), buffer.size());
+    }
+
+private:
+    const TaskStore& store;
+    bool showCreated;
+
+    // Left-aligned and padded to width, like setw(width) << left
+    static void cell(string& out, string_view text, size_t width) {
+        out += text;
+        if (text.size() < width) out.append(width - text.size(), ' ');
+    }
+};
+
+// Hashed index over the user file ("userID hash" per line), kept on disk
+// next to it as user_details.idx, so checking an account never reads the
+// whole user file. The index is a table of fixed-width buckets, each the
+// hash of a user ID and the offset of that user's line, probed in place: a
+// lookup reads a bucket or two and one line. The header records how many
+// bytes of the user file are indexed, so staying current is a size check,
+// and lines appended by anything else are indexed from there. The table is
+// rebuilt at double the size once it would be over half full.
+//
+// Index file layout (little-endian):
+//   header   "TDLU", version, bucket count (a power of two), account count,
+//            user file bytes indexed
+//   buckets  (tag, line offset) pairs; tag 0 marks an empty bucket
+class UserStore {
+public:
+    explicit UserStore(const string& filePath)
+        : path(filePath), indexPath(filesystem::path(filePath).replace_extension(".idx").string()) {}
+
+    // Whether the user file could be read
+    bool is_available() {
+        FILE* users = fopen(path.c_str(), "rb");
+        if (!users) {
+            return false;
+        }
+        fclose(users);
+        return true;
+    }
+
+    bool exists(const string& userID) {
+        string hash;
+        return lookup(userID, hash);
+    }
+
+    bool verify(const string& userID, const string& passwordHash) {
+        MetricTimer timer(METRIC_LOGIN);
+        string hash;
+        return lookup(userID, hash) && hash == passwordHash;
+    }
+
+    // Append the account's line, then index it
+    bool add(const string& userID, const string& passwordHash) {
+        FILE* users = fopen(path.c_str(), "a+b");
+        if (!users) {
+            return false;
+        }
+        lock_file(users, true);
+        string line = userID + " " + passwordHash + "\n";
+        bool written = fwrite(line.data(), 1, line.size(), users) == line.size() && fflush(users) == 0;
+        if (written) {
+            update(users);
+        }
+        fclose(users);
+        return written;
+    }
+
+private:
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 32;
+    static const size_t BUCKET_SIZE = 16;
+
+    struct Header {
+        uint64_t buckets = 0;
+        uint64_t accounts = 0;
+        uint64_t indexed = 0; // Bytes of the user file
+    };
+
+    enum ProbeResult { PROBE_FOUND, PROBE_EMPTY, PROBE_FAILED };
+
+    string path;
+    string indexPath;
+
+    // Find the account's password hash. Processes share the user file and
+    // its index through a lock on the user file: shared to look up,
+    // exclusive to index.
+    bool lookup(const string& userID, string& hash) {
+        FILE* users = fopen(path.c_str(), "rb");
+        if (!users) {
+            return false;
+        }
+        lock_file(users, false);
+        uint64_t size = fileSize(users);
+        Header header;
+        FILE* index = fopen(indexPath.c_str(), "rb");
+        if (!index || !readHeader(index, header) || header.indexed != size) {
+            if (index) fclose(index);
+            lock_file(users, true);
+            index = update(users) ? fopen(indexPath.c_str(), "rb") : nullptr;
+            if (index && !readHeader(index, header)) {
+                fclose(index);
+                index = nullptr;
+            }
+        }
+
+        bool found;
+        if (index) {
+            uint64_t slot;
+            found = probe(index, users, header, userID, slot, &hash) == PROBE_FOUND;
+            fclose(index);
+        } else {
+            // No usable index, say in a read-only directory: read the file
+            found = scan(users, size, userID, hash);
+        }
+        fclose(users);
+        return found;
+    }
+
+    // Index the lines appended since the index was written, or write it
+    // again if it is missing, does not match the user file or would be over
+    // half full; false if the index could not be brought up to date. The
+    // caller holds the user file's lock exclusively.
+    bool update(FILE* users) {
+        uint64_t size = fileSize(users);
+        Header header;
+        FILE* index = fopen(indexPath.c_str(), "r+b");
+        if (index && readHeader(index, header) && header.indexed <= size) {
+            string tail = readRange(users, header.indexed, size);
+            size_t end = tail.rfind('\n') + 1; // Only complete lines; 0 if none
+            size_t lines = count(tail.begin(), tail.begin() + end, '\n');
+            if (lines == 0 ||
+                ((header.accounts + lines) * 2 <= header.buckets && indexTail(index, users, header, tail.substr(0, end)))) {
+                fclose(index);
+                return true;
+            }
+        }
+        if (index) fclose(index);
+        return rebuild(users, size);
+    }
+
+    // Add the accounts of the complete lines in tail, which starts where the
+    // index ends, then move the header past them
+    bool indexTail(FILE* index, FILE* users, Header& header, const string& tail) {
+        size_t start = 0;
+        while (start < tail.size()) {
+            size_t end = tail.find('\n', start);
+            string_view userID, hash;
+            if (parseLine(string_view(tail).substr(start, end - start), userID, hash)) {
+                uint64_t slot;
+                ProbeResult result = probe(index, users, header, userID, slot, nullptr);
+                if (result == PROBE_FAILED) {
+                    return false;
+                }
+                // An ID that is already there keeps its first line
+                if (result == PROBE_EMPTY) {
+                    if (!writeBucket(index, slot, tagOf(userID), header.indexed + start)) {
+                        return false;
+                    }
+                    header.accounts++;
+                }
+            }
+            start = end + 1;
+        }
+        header.indexed += tail.size();
+        string bytes = encodeHeader(header);
+        return fseek(index, 0, SEEK_SET) == 0 && fwrite(bytes.data(), 1, bytes.size(), index) == bytes.size() &&
+               fflush(index) == 0;
+    }
+
+    // Write the index from scratch, with at least twice as many buckets as accounts
+    bool rebuild(FILE* users, uint64_t size) {
+        string data = readRange(users, 0, size);
+        size_t end = data.rfind('\n') + 1;
+        size_t lines = count(data.begin(), data.begin() + end, '\n');
+        Header header;
+        header.buckets = 64;
+        while (header.buckets < 2 * (lines + 1)) header.buckets *= 2;
+        header.indexed = end;
+
+        vector<uint64_t> table(2 * header.buckets, 0); // (tag, offset) per bucket
+        uint64_t mask = header.buckets - 1;
+        size_t start = 0;
+        while (start < end) {
+            size_t lineEnd = data.find('\n', start);
+            string_view userID, hash;
+            if (parseLine(string_view(data).substr(start, lineEnd - start), userID, hash)) {
+                uint64_t tag = tagOf(userID);
+                for (uint64_t slot = tag & mask; ; slot = (slot + 1) & mask) {
+                    if (table[2 * slot] == 0) {
+                        table[2 * slot] = tag;
+                        table[2 * slot + 1] = start;
+                        header.accounts++;
+                        break;
+                    }
+                    string_view other, otherHash;
+                    size_t offset = table[2 * slot + 1];
+                    if (table[2 * slot] == tag &&
+                        parseLine(string_view(data).substr(offset, data.find('\n', offset) - offset), other, otherHash) &&
+                        other == userID) {
+                        break;
+                    }
+                }
+            }
+            start = lineEnd + 1;
+        }
+
+        string out = encodeHeader(header);
+        out.reserve(out.size() + table.size() * 8);
+        for (uint64_t v : table) put_u64(out, v);
+        return write_file_atomic(indexPath, out);
+    }
+
+    // Probe for userID. On a hit slot is its bucket and hash, if given, gets
+    // its password hash; on a miss slot is the empty bucket that ended the probe.
+    ProbeResult probe(FILE* index, FILE* users, const Header& header, string_view userID,
+                      uint64_t& slot, string* hash) {
+        uint64_t tag = tagOf(userID);
+        uint64_t mask = header.buckets - 1;
+        string line;
+        slot = tag & mask;
+        for (uint64_t step = 0; step < header.buckets; step++, slot = (slot + 1) & mask) {
+            uint64_t bucketTag, offset;
+            if (!readBucket(index, slot, bucketTag, offset)) {
+                return PROBE_FAILED;
+            }
+            if (bucketTag == 0) {
+                return PROBE_EMPTY;
+            }
+            string_view id, passwordHash;
+            if (bucketTag == tag && readLine(users, offset, line) && parseLine(line, id, passwordHash) && id == userID) {
+                if (hash) *hash = string(passwordHash);
+                return PROBE_FOUND;
+            }
+        }
+        return PROBE_FAILED;
     }
 
-    Task(const string& desc, const string& date, Priority prio) {
-        description = desc;
-        dueDate = date;
-        priority = prio;
-        status = PENDING;
-        createdDate = time(0);
-        completedDate = 0;
+    bool scan(FILE* users, uint64_t size, string_view userID, string& hash) {
+        string data = readRange(users, 0, size);
+        size_t start = 0;
+        while (start < data.size()) {
+            size_t end = data.find('\n', start);
+            if (end == string::npos) break; // A partial line is not an account yet
+            string_view id, passwordHash;
+            if (parseLine(string_view(data).substr(start, end - start), id, passwordHash) && id == userID) {
+                hash = string(passwordHash);
+                return true;
+            }
+            start = end + 1;
+        }
+        return false;
     }
 
-    string getPriorityString() const {
-        switch (priority) {
-            case LOW: return "Low";
-            case MEDIUM: return "Medium";
-            case HIGH: return "High";
-            default: return "Unknown";
+    // FNV-1a, never 0
+    static uint64_t tagOf(string_view userID) {
+        uint64_t h = 14695981039346656037ull;
+        for (char c : userID) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
         }
+        return h ? h : 1;
     }
 
-    string getStatusString() const {
-        switch (status) {
-            case PENDING: return "Pending";
-            case IN_PROGRESS: return "In Progress";
-            case COMPLETED: return "Completed";
-            default: return "Unknown";
+    // "userID hash", separated by blanks; anything after is ignored
+    static bool parseLine(string_view line, string_view& userID, string_view& hash) {
+        auto field = [&line](string_view& out) {
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == string_view::npos) return false;
+            size_t end = min(line.find_first_of(" \t\r", start), line.size());
+            out = line.substr(start, end - start);
+            line.remove_prefix(end);
+            return true;
+        };
+        return field(userID) && field(hash);
+    }
+
+    static string encodeHeader(const Header& header) {
+        string bytes = "TDLU";
+        put_u32(bytes, VERSION);
+        put_u64(bytes, header.buckets);
+        put_u64(bytes, header.accounts);
+        put_u64(bytes, header.indexed);
+        return bytes;
+    }
+
+    // Read and check the header, including that the file holds every bucket
+    static bool readHeader(FILE* index, Header& header) {
+        char bytes[HEADER_SIZE];
+        if (fseek(index, 0, SEEK_SET) != 0 || fread(bytes, 1, HEADER_SIZE, index) != HEADER_SIZE ||
+            memcmp(bytes, "TDLU", 4) != 0) {
+            return false;
         }
+        ByteReader in(bytes + 4, HEADER_SIZE - 4);
+        if (in.u32() != VERSION) {
+            return false;
+        }
+        header.buckets = in.u64();
+        header.accounts = in.u64();
+        header.indexed = in.u64();
+        return header.buckets > 0 && (header.buckets & (header.buckets - 1)) == 0 &&
+               header.accounts < header.buckets && header.buckets <= (UINT64_MAX - HEADER_SIZE) / BUCKET_SIZE &&
+               fileSize(index) == HEADER_SIZE + header.buckets * BUCKET_SIZE;
     }
 
-    string getFormattedDate(time_t timestamp) const {
-        struct tm* timeinfo = localtime(&timestamp);
-        char buffer[80];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d", timeinfo);
-        return string(buffer);
+    static bool readBucket(FILE* index, uint64_t slot, uint64_t& tag, uint64_t& offset) {
+        char bytes[BUCKET_SIZE];
+        if (fseek(index, static_cast<long>(HEADER_SIZE + slot * BUCKET_SIZE), SEEK_SET) != 0 ||
+            fread(bytes, 1, BUCKET_SIZE, index) != BUCKET_SIZE) {
+            return false;
+        }
+        ByteReader in(bytes, BUCKET_SIZE);
+        tag = in.u64();
+        offset = in.u64();
+        return true;
+    }
+
+    static bool writeBucket(FILE* index, uint64_t slot, uint64_t tag, uint64_t offset) {
+        string bytes;
+        put_u64(bytes, tag);
+        put_u64(bytes, offset);
+        return fseek(index, static_cast<long>(HEADER_SIZE + slot * BUCKET_SIZE), SEEK_SET) == 0 &&
+               fwrite(bytes.data(), 1, bytes.size(), index) == bytes.size();
+    }
+
+    // The line starting at offset, without its newline
+    static bool readLine(FILE* users, uint64_t offset, string& line) {
+        line.clear();
+        if (fseek(users, static_cast<long>(offset), SEEK_SET) != 0) {
+            return false;
+        }
+        int c;
+        while ((c = getc(users)) != EOF && c != '\n') {
+            line.push_back(static_cast<char>(c));
+        }
+        return true;
+    }
+
+    static string readRange(FILE* file, uint64_t from, uint64_t to) {
+        string data(static_cast<size_t>(to - from), '\0');
+        if (fseek(file, static_cast<long>(from), SEEK_SET) != 0) {
+            return "";
+        }
+        data.resize(fread(&data[0], 1, data.size(), file));
+        Metrics::read(data.size());
+        return data;
+    }
+
+    static uint64_t fileSize(FILE* file) {
+        if (fseek(file, 0, SEEK_END) != 0) return 0;
+        long size = ftell(file);
+        return size < 0 ? 0 : static_cast<uint64_t>(size);
+    }
+};
+
+// Creates and checks the task storage directories once per process, before
+// any task file is touched, and moves files from the old flat layout
+// (everything in tasks/) into the index/ and log/ subdirectories.
+class StorageLayout {
+public:
+    // The process-wide layout, set up on first use
+    static const StorageLayout& instance() {
+        static StorageLayout layout;
+        return layout;
+    }
+
+    // Whether task files can be written
+    bool ready() const {
+        return writable;
+    }
+
+private:
+    bool writable;
+
+    StorageLayout() : writable(false) {
+        error_code ec;
+        for (const string& dir : {TASKS_DIR, INDEX_DIR, LOG_DIR}) {
+            filesystem::create_directories(dir, ec);
+            if (ec) {
+                cerr << "Error: Unable to create " << dir << ": " << ec.message() << endl;
+                return;
+            }
+        }
+
+        // Permissions are checked by writing, which also covers read-only mounts
+        string probe = TASKS_DIR + ".write_test";
+        FILE* file = fopen(probe.c_str(), "wb");
+        if (!file) {
+            cerr << "Error: No write permission in " << TASKS_DIR << "." << endl;
+            return;
+        }
+        fclose(file);
+        remove(probe.c_str());
+        writable = true;
+
+        filesystem::space_info space = filesystem::space(TASKS_DIR, ec);
+        if (!ec && space.available < MIN_FREE_SPACE) {
+            cerr << "Warning: Only " << (space.available >> 20) << " MB of disk space left for tasks." << endl;
+        }
+
+        migrateFlatLayout();
+    }
+
+    void migrateFlatLayout() {
+        error_code ec;
+        for (const auto& entry : filesystem::directory_iterator(TASKS_DIR, ec)) {
+            if (!entry.is_regular_file(ec)) continue;
+            string name = entry.path().filename().string();
+            const string* target = nullptr;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".idx") == 0) {
+                target = &INDEX_DIR;
+            } else if (name.find(".log") != string::npos) {
+                target = &LOG_DIR;
+            }
+            if (target) {
+                filesystem::rename(entry.path(), *target + name, ec);
+            }
+        }
     }
 };
 
+// Simple password hashing function
+string hash_password(const string& password) {
+    unsigned long hash = 5381;
+    for (char c : password) {
+        hash = ((hash << 5) + hash) + c; // hash * 33 + c
+    }
+    stringstream ss;
+    ss << hex << hash;
+    return ss.str();
+}
+
 class TaskManager {
 private:
-    vector<Task> tasks;
+    TaskStore tasks;
     string userID;
     bool isLoggedIn;
+    UserStore users;
+
+    shared_ptr<PersistQueue> writes; // Performed on the TaskWriter thread
+    bool logActive;  // A log for the current generation exists or is queued
+    size_t logBytes;
+    uint64_t snapshotGen;
+    uint64_t diskGen;      // Generation of the snapshot file on disk
+    uint64_t keptLogFrom;  // Oldest rotated log that may still be needed
+    bool inBatch;
+    bool batchSnapshot;    // The open batch outgrew batchLog and is saved as a snapshot
+    string batchLog;       // Records of the open batch, each after its length
+    uint64_t batchRecords;
+    TaskOrder listOrder;   // Order the task list is shown and exported in
+
+    string snapshotFilePath() const {
+        return TASKS_DIR + userID + ".bin";
+    }
 
-    // Simple password hashing function
-    string hashPassword(const string& password) {
-        unsigned long hash = 5381;
-        for (char c : password) {
-            hash = ((hash << 5) + hash) + c; // hash * 33 + c
-        }
-        stringstream ss;
-        ss << hex << hash;
-        return ss.str();
+    // The snapshot before the current one, kept for recovery
+    string previousSnapshotPath() const {
+        return snapshotFilePath() + ".prev";
     }
 
-    // Save tasks to file
-    void save_tasks() {
-        #ifdef _WIN32
-        system(("mkdir " + TASKS_DIR + " 2>nul").c_str());
-        #else
-        system(("mkdir -p " + TASKS_DIR).c_str());
-        #endif
+    // Secondary indexes saved alongside the snapshot
+    string indexFilePath() const {
+        return INDEX_DIR + userID + ".idx";
+    }
+
+    // Pipe-delimited text format used before binary snapshots
+    string textFilePath() const {
+        return TASKS_DIR + userID + ".txt";
+    }
+
+    string logFilePath() const {
+        return LOG_DIR + userID + ".log";
+    }
+
+    // Log that was rotated out by a compaction of generation gen
+    string rotatedLogPath(uint64_t gen) const {
+        return logFilePath() + "." + to_string(gen);
+    }
+
+
+    // Start a fresh, empty mutation log for the current snapshot generation
+    void openLog() {
+        string header = "TDLW";
+        put_u32(header, LOG_VERSION);
+        put_u64(header, snapshotGen);
+        logBytes = header.size();
+        writes->push({PersistOp::RESET_LOG, logFilePath(), move(header), "", "", "", "", {}});
+        logActive = true;
+    }
 
-        ofstream outFile(TASKS_DIR + userID + ".txt");
-        if (!outFile.is_open()) {
-            cerr << "Error: Unable to save tasks." << endl;
+    // Queue one add/update/delete record for the log and return; the writer
+    // thread appends it, together with any others queued meanwhile. An order
+    // record carries the new TaskOrder in place of the task ID.
+    void logMutation(LogOp op, uint64_t taskId, const Task* task = nullptr) {
+        if (!logActive) {
+            save_tasks();
             return;
         }
+        appendLogRecord(logPayload(op, taskId, task));
+    }
 
-        for (const auto& task : tasks) {
-            outFile << task.description << "|"
-                    << task.dueDate << "|"
-                    << static_cast<int>(task.priority) << "|"
-                    << static_cast<int>(task.status) << "|"
-                    << task.createdDate << "|"
-                    << task.completedDate << endl;
+    static string logPayload(LogOp op, uint64_t taskId, const Task* task) {
+        string payload;
+        put_u8(payload, static_cast<uint8_t>(op));
+        put_u64(payload, taskId);
+        if (task) {
+            put_u8(payload, static_cast<uint8_t>(task->priority));
+            put_u8(payload, static_cast<uint8_t>(task->status));
+            put_u64(payload, static_cast<uint64_t>(task->createdDate));
+            put_u64(payload, static_cast<uint64_t>(task->completedDate));
+            put_u32(payload, static_cast<uint32_t>(task->dueDay));
+            put_str(payload, task->description);
         }
-        outFile.close();
+        return payload;
     }
 
-    // Load tasks from file
-    void load_tasks() {
-        ifstream inFile(TASKS_DIR + userID + ".txt");
+    // Frame a record with its length and checksum and queue it; a torn or
+    // corrupt record is dropped whole when the log is replayed
+    void appendLogRecord(const string& payload) {
+        string record;
+        put_u32(record, static_cast<uint32_t>(payload.size()));
+        put_u32(record, crc32(payload.data(), payload.size()));
+        record += payload;
+
+        writes->append(logFilePath(), record);
+        logBytes += record.size();
+
+        if (logBytes > LOG_COMPACT_THRESHOLD) {
+            compactLog();
+        }
+    }
+
+    // Start a new log and leave folding the old one into a snapshot to the
+    // writer thread, which builds it from the files rather than from the
+    // tasks in memory, so this costs the same at any task count
+    void compactLog() {
+        uint64_t gen = snapshotGen;
+        PersistOp op = {PersistOp::COMPACT, logFilePath(), "", rotatedLogPath(gen),
+                        snapshotFilePath(), indexFilePath(), "", {}};
+        op.build = [id = userID, gen](string& data, string& indexData) {
+            return buildSnapshot(id, gen, data, indexData);
+        };
+        // As in save_tasks()
+        for (uint64_t old = keptLogFrom; old < diskGen; old++) {
+            op.obsoleteLogs.push_back(rotatedLogPath(old));
+        }
+        keptLogFrom = diskGen;
+        writes->push(move(op));
+        snapshotGen++;
+        diskGen = snapshotGen;
+        openLog();
+    }
+
+    // Writer side of compactLog(): load the user's snapshot on disk into a
+    // TaskManager of its own, replay the rotated logs after it up to and
+    // including generation gen's, and encode the result as generation gen + 1
+    static bool buildSnapshot(const string& userID, uint64_t gen, string& data, string& indexData) {
+        TaskManager builder;
+        builder.userID = userID;
+        MappedFile snapshot(builder.snapshotFilePath());
+        if (snapshot.is_open() ? !builder.loadSnapshot(snapshot) : gen != 0) {
+            return false;
+        }
+        bool damaged = false;
+        while (builder.snapshotGen <= gen) {
+            if (!builder.replayLog(builder.rotatedLogPath(builder.snapshotGen), builder.snapshotGen, damaged) ||
+                damaged) {
+                return false;
+            }
+            builder.snapshotGen++;
+        }
+        builder.tasks.compact();
+        builder.tasks.advanceOverdue(current_day());
+        data = builder.encodeSnapshot(gen + 1);
+        indexData = builder.tasks.encodeIndexes(gen + 1);
+        return true;
+    }
+
+    // Apply the records of a log written against generation gen.
+    // Returns false if the file is missing or belongs to another generation;
+    // needsCompaction is set when a torn or corrupt tail had to be dropped or
+    // the log uses an older record layout, so it must not be appended to.
+    bool replayLog(const string& path, uint64_t gen, bool& needsCompaction) {
+        needsCompaction = false;
+        ifstream inFile(path, ios::binary);
         if (!inFile.is_open()) {
-            return;
+            return false;
         }
+        string data((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+        inFile.close();
+        Metrics::read(data.size());
 
-        tasks.clear();
-        string line;
-        while (getline(inFile, line)) {
-            vector<string> parts;
-            stringstream ss(line);
-            string part;
-            while (getline(ss, part, '|')) {
-                parts.push_back(part);
+        ByteReader header(data.data(), data.size());
+        if (data.compare(0, 4, "TDLW") != 0 || !header.has(16)) {
+            return false;
+        }
+        header.p += 4;
+        uint32_t version = header.u32();
+        if (version < 1 || version > LOG_VERSION || header.u64() != gen) {
+            return false;
+        }
+        bool damaged = false;
+
+        const char* p = header.p;
+        const char* end = data.data() + data.size();
+        while (p < end) {
+            ByteReader frame(p, end - p);
+            uint32_t length = frame.u32();
+            uint32_t checksum = frame.u32();
+            if (!frame.has(length) || crc32(frame.p, length) != checksum) {
+                damaged = true;
+                break;
             }
 
-            if (parts.size() >= 6) {
-                Task task;
-                task.description = parts[0];
-                task.dueDate = parts[1];
-                task.priority = static_cast<Priority>(stoi(parts[2]));
-                task.status = static_cast<TaskStatus>(stoi(parts[3]));
-                task.createdDate = stoll(parts[4]);
-                task.completedDate = stoll(parts[5]);
-                tasks.push_back(task);
+            ByteReader rec(frame.p, length);
+            if (!applyLogRecord(rec, version)) {
+                damaged = true;
+                break;
             }
+            p = frame.p + length;
         }
-        inFile.close();
+
+        if (damaged) {
+            cerr << "Warning: Task log " << path << " is damaged; "
+                 << (end - p) << " trailing bytes were ignored." << endl;
+        }
+        needsCompaction = damaged || version != LOG_VERSION;
+        return true;
+    }
+
+    // Read the fields of one record; false if it is malformed
+    static bool readLogRecord(ByteReader& rec, uint32_t version, LogOp& op, uint64_t& taskId, Task& task) {
+        op = static_cast<LogOp>(rec.u8());
+        taskId = version < 3 ? rec.u32() : rec.u64();
+        if (op == LOG_ADD || op == LOG_UPDATE) {
+            task.priority = static_cast<Priority>(rec.u8());
+            task.status = static_cast<TaskStatus>(rec.u8());
+            task.createdDate = static_cast<time_t>(rec.u64());
+            task.completedDate = static_cast<time_t>(rec.u64());
+            if (version == 1) {
+                string date = rec.str();
+                if (!parse_date(date.data(), date.size(), task.dueDay)) {
+                    task.dueDay = DUE_NONE;
+                }
+            } else {
+                task.dueDay = static_cast<int32_t>(rec.u32());
+            }
+            task.description = rec.str();
+        }
+        return rec.ok;
     }
 
-    // Validate date format (YYYY-MM-DD)
-    bool isValidDate(const string& date) {
-        if (date.length() != 10) return false;
-        if (date[4] != '-' || date[7] != '-') return false;
+    // Apply one log record to the tasks; false if it is malformed or does
+    // not fit them. A group record carries its count in place of the task ID.
+    bool applyLogRecord(ByteReader& rec, uint32_t version) {
+        LogOp op;
+        uint64_t taskId;
+        Task task;
+        bool applied = readLogRecord(rec, version, op, taskId, task);
+        if (applied && op == LOG_GROUP && version >= 4) {
+            return applyLogGroup(rec, taskId, version);
+        }
+
+        size_t row = 0;
+        bool found;
+        if (version < 3) {
+            // Versions 1-2 name a task by its position in the list, which
+            // is its row as long as deleted rows are compacted right away
+            row = static_cast<size_t>(taskId);
+            found = row < tasks.size();
+            applied = applied && (op != LOG_ADD || row == tasks.size());
+            taskId = 0;
+        } else {
+            found = tasks.find(taskId, row);
+        }
+
+        if (applied && op == LOG_ORDER && version >= 3 && taskId <= ORDER_CREATED) {
+            listOrder = static_cast<TaskOrder>(taskId);
+        } else if (applied && op == LOG_ADD && !found) {
+            task.id = taskId;
+            tasks.push_back(task);
+        } else if (applied && op == LOG_UPDATE && found) {
+            tasks.set(row, task);
+        } else if (applied && op == LOG_DELETE && found) {
+            tasks.erase(row);
+            if (version < 3) tasks.compact();
+        } else {
+            applied = false;
+        }
+        return applied;
+    }
+
+    // Apply count records of a batch, or none of them. The records share
+    // the group's checksum, so a torn group never gets here; the rest are
+    // checked against the tasks first, following the IDs the group itself
+    // adds and deletes, since it may update a task it has just added.
+    bool applyLogGroup(ByteReader& rec, uint64_t count, uint32_t version) {
+        ByteReader check = rec;
+        unordered_map<uint64_t, bool> exists; // Task ID to whether it is live after the group so far
+        for (uint64_t i = 0; i < count; i++) {
+            uint32_t length = check.u32();
+            if (!check.has(length)) {
+                return false;
+            }
+            ByteReader inner(check.p, length);
+            check.p += length;
+            LogOp op;
+            uint64_t taskId;
+            Task task;
+            if (!readLogRecord(inner, version, op, taskId, task)) {
+                return false;
+            }
+            if (op == LOG_ORDER) {
+                if (taskId > ORDER_CREATED) return false;
+                continue;
+            }
+            if (op != LOG_ADD && op != LOG_UPDATE && op != LOG_DELETE) {
+                return false;
+            }
+            size_t row;
+            auto known = exists.find(taskId);
+            bool live = known != exists.end() ? known->second : tasks.find(taskId, row);
+            if ((op == LOG_ADD) == live) {
+                return false;
+            }
+            if (op != LOG_UPDATE) {
+                exists[taskId] = op == LOG_ADD;
+            }
+        }
+        if (check.p != check.end) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+            uint32_t length = rec.u32();
+            ByteReader inner(rec.p, length);
+            rec.p += length;
+            applyLogRecord(inner, version);
+        }
+        return true;
+    }
+
+    // Binary snapshot layout (little-endian):
+    //   header  "TDLB", version, generation, count, record size, heap size, CRC-32,
+    //           list order, next task ID
+    //   records fixed-width, one per task, pointing into the heap
+    //   heap    all descriptions back to back
+    // The tasks must be compacted first.
+    string encodeSnapshot(uint64_t gen) const {
+        string records;
+        const string& heap = tasks.textHeap;
+        records.reserve(tasks.size() * SNAPSHOT_RECORD_SIZE);
+        for (size_t i = 0; i < tasks.size(); i++) {
+            put_u32(records, tasks.descriptionSpan[i].offset);
+            put_u32(records, tasks.descriptionSpan[i].length);
+            put_u32(records, static_cast<uint32_t>(tasks.dueDay[i]));
+            put_u8(records, tasks.priority[i]);
+            put_u8(records, tasks.status[i]);
+            put_u8(records, 0);
+            put_u8(records, 0);
+            put_u64(records, static_cast<uint64_t>(tasks.createdDate[i]));
+            put_u64(records, static_cast<uint64_t>(tasks.completedDate[i]));
+            put_u64(records, tasks.id[i]);
+        }
+
+        string data = "TDLB";
+        put_u32(data, SNAPSHOT_VERSION);
+        put_u64(data, gen);
+        put_u32(data, static_cast<uint32_t>(tasks.size()));
+        put_u32(data, static_cast<uint32_t>(SNAPSHOT_RECORD_SIZE));
+        put_u64(data, heap.size());
+        put_u32(data, crc32(heap.data(), heap.size(), crc32(records.data(), records.size())));
+        put_u32(data, static_cast<uint32_t>(listOrder));
+        put_u64(data, tasks.nextId);
+        data.reserve(data.size() + records.size() + heap.size());
+        data += records;
+        data += heap;
+        return data;
+    }
+
+    // Decode a memory-mapped binary snapshot; returns false if it is unusable.
+    // Version 1 snapshots have no task IDs; their tasks are numbered in order.
+    // The load is eager: the whole file is checked against its CRC and copied
+    // into the store's columns and text heap before any of it is used. The
+    // columns feed the indexes and counts and are edited in place, and a damaged
+    // file is only caught here, while the previous save can still stand in.
+    // The mapping saves the read() copy and the parsing, not the page touches.
+    bool loadSnapshot(const MappedFile& file) {
+        ByteReader header(file.data, file.size);
+        if (!header.has(SNAPSHOT_V1_HEADER_SIZE) || memcmp(file.data, "TDLB", 4) != 0) {
+            return false;
+        }
+        header.p += 4;
+        uint32_t version = header.u32();
+        uint64_t gen = header.u64();
+        uint32_t count = header.u32();
+        uint32_t recordSize = header.u32();
+        uint64_t heapSize = header.u64();
+        uint32_t checksum = header.u32();
+        uint32_t order = header.u32();
+
+        size_t headerSize = version == 1 ? SNAPSHOT_V1_HEADER_SIZE : SNAPSHOT_HEADER_SIZE;
+        size_t expectedRecordSize = version == 1 ? SNAPSHOT_V1_RECORD_SIZE : SNAPSHOT_RECORD_SIZE;
+        const char* records = file.data + headerSize;
+        uint64_t recordBytes = static_cast<uint64_t>(count) * recordSize;
+        if (version < 1 || version > SNAPSHOT_VERSION || recordSize != expectedRecordSize ||
+            file.size != headerSize + recordBytes + heapSize) {
+            return false;
+        }
+        uint64_t nextId = version == 1 ? 1 : header.u64();
+        const char* heap = records + recordBytes;
+        if (crc32(heap, heapSize, crc32(records, recordBytes)) != checksum) {
+            return false;
+        }
+
+        tasks.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            ByteReader rec(records + static_cast<size_t>(i) * recordSize, recordSize);
+            uint32_t offset = rec.u32();
+            uint32_t length = rec.u32();
+            tasks.dueDay[i] = static_cast<int32_t>(rec.u32());
+            tasks.priority[i] = rec.u8();
+            tasks.status[i] = rec.u8();
+            rec.p += 2;
+            tasks.createdDate[i] = static_cast<int64_t>(rec.u64());
+            tasks.completedDate[i] = static_cast<int64_t>(rec.u64());
+            tasks.id[i] = version == 1 ? i + 1 : rec.u64();
+            if (static_cast<uint64_t>(offset) + length > heapSize) {
+                tasks.clear();
+                return false;
+            }
+            tasks.descriptionSpan[i] = {offset, length};
+        }
+        tasks.loadText(heap, heapSize);
+        tasks.nextId = nextId;
+        tasks.rebuildIds();
+        listOrder = version == 1 || order > ORDER_CREATED ? ORDER_LIST : static_cast<TaskOrder>(order);
+        snapshotGen = gen;
+
+        MappedFile index(indexFilePath());
+        if (!index.is_open() || !tasks.loadIndexes(index, gen)) {
+            tasks.rebuildIndexes();
+        }
+        return true;
+    }
+
+    // Read a legacy pipe-delimited task file
+    void loadTextSnapshot(ifstream& inFile) {
+        TextTaskReader reader(inFile);
+        Task task;
+        while (reader.next(task)) {
+            tasks.append(task);
+        }
+        tasks.rebuildIndexes();
+        snapshotGen = reader.generation;
+
+        if (reader.errorCount > 0) {
+            cerr << "Warning: Skipped " << reader.errorCount << " malformed line(s) in "
+                 << textFilePath() << ":" << endl;
+            for (const auto& error : reader.errors) {
+                cerr << "  " << error << endl;
+            }
+        }
+    }
+
+    // Save tasks to file: write a fresh snapshot and start a new mutation log.
+    // The snapshot is encoded here and written out by the writer thread. The
+    // snapshot it replaces is kept as .prev, together with the rotated logs
+    // that bring it up to date, so a damaged snapshot can be recovered.
+    void save_tasks() {
+        MetricTimer timer(METRIC_SAVE);
+        // At most one snapshot in flight keeps memory bounded
+        writes->flush();
+        tasks.compact();
+        // The saved counts are then current for anyone logging in today
+        tasks.advanceOverdue(current_day());
+
+        PersistOp op = {PersistOp::SNAPSHOT, logActive ? logFilePath() : "",
+                        encodeSnapshot(snapshotGen + 1), rotatedLogPath(snapshotGen),
+                        snapshotFilePath(), indexFilePath(), tasks.encodeIndexes(snapshotGen + 1), {}};
+        // The snapshot on disk becomes .prev; older logs are no longer needed
+        for (uint64_t gen = keptLogFrom; gen < diskGen; gen++) {
+            op.obsoleteLogs.push_back(rotatedLogPath(gen));
+        }
+        keptLogFrom = diskGen;
+        writes->push(move(op));
+        snapshotGen++;
+        diskGen = snapshotGen;
+        openLog();
+    }
+
+    // Generation from a snapshot file's header, without loading it
+    static bool readSnapshotGeneration(const string& path, uint64_t& gen) {
+        char header[16];
+        ifstream inFile(path, ios::binary);
+        if (!inFile.read(header, sizeof(header)) || memcmp(header, "TDLB", 4) != 0) {
+            return false;
+        }
+        ByteReader reader(header + 8, 8);
+        gen = reader.u64();
+        return true;
+    }
+
+    // Fall back to the snapshot kept by the last save
+    bool loadPreviousSnapshot() {
+        MappedFile previous(previousSnapshotPath());
+        if (previous.is_open() && loadSnapshot(previous)) {
+            return true;
+        }
+        tasks.clear();
+        snapshotGen = 0;
+        return false;
+    }
+
+    // Load tasks from file: read the snapshot, then replay the mutation logs
+    void load_tasks() {
+        MetricTimer timer(METRIC_LOAD);
+        writes->flush();
+        tasks.clear();
+        listOrder = ORDER_LIST;
+        logActive = false;
+        snapshotGen = 0;
+
+        bool migrated = false;
+        bool fromPrevious = false;
+        MappedFile snapshot(snapshotFilePath());
+        if (snapshot.is_open() && !loadSnapshot(snapshot)) {
+            cerr << "Error: Task file " << snapshotFilePath() << " is corrupt; "
+                 << "it has been moved aside." << endl;
+            rename(snapshotFilePath().c_str(), (snapshotFilePath() + ".corrupt").c_str());
+            fromPrevious = loadPreviousSnapshot();
+        } else if (!snapshot.is_open()) {
+            ifstream inFile(textFilePath());
+            if (inFile.is_open()) {
+                loadTextSnapshot(inFile);
+                migrated = true;
+            } else {
+                fromPrevious = loadPreviousSnapshot();
+            }
+        }
+        diskGen = snapshotGen;
+        // Rotated logs from the previous snapshot's generation on are kept
+        keptLogFrom = diskGen;
+        uint64_t previousGen = 0;
+        if (readSnapshotGeneration(previousSnapshotPath(), previousGen) && previousGen < diskGen) {
+            keptLogFrom = previousGen;
+        }
+
+        // Rotated logs newer than the snapshot exist if a compaction was cut
+        // short, or if we fell back to the previous snapshot; replay them in order
+        bool recovered = false;
+        bool damaged = false;
+        bool rotatedNeedsCompaction = false;
+        while (!damaged && replayLog(rotatedLogPath(snapshotGen), snapshotGen, rotatedNeedsCompaction)) {
+            snapshotGen++;
+            recovered = true;
+            damaged = rotatedNeedsCompaction;
+        }
+
+        bool logNeedsCompaction = false;
+        bool replayed = !damaged && replayLog(logFilePath(), snapshotGen, logNeedsCompaction);
+        if (damaged) {
+            cerr << "Warning: A task log is damaged; changes after generation "
+                 << snapshotGen << " could not be recovered." << endl;
+        }
+        if (fromPrevious) {
+            cerr << "Recovered tasks from the previous save." << endl;
+        }
+
+        // Counts saved on an earlier day catch up with the days since
+        tasks.advanceOverdue(current_day());
+
+        // A replayed log is rotated by the compaction below, or appended to
+        logActive = replayed;
+        if (recovered || logNeedsCompaction || migrated || fromPrevious || damaged) {
+            // Fold everything into a new snapshot so the log starts clean
+            save_tasks();
+            writes->flush();
+        } else if (replayed) {
+            ifstream logIn(logFilePath(), ios::binary | ios::ate);
+            logBytes = static_cast<size_t>(logIn.tellg());
+        } else {
+            openLog();
+        }
+    }
 
-        for (int i = 0; i < 10; i++) {
-            if (i == 4 || i == 7) continue;
-            if (!isdigit(date[i])) return false;
+    // Log a mutation, or hold it for the open batch's log group. A batch
+    // that outgrows BATCH_SNAPSHOT_THRESHOLD stops indexing and collecting
+    // records, and is saved as a whole snapshot instead.
+    void persist(LogOp op, uint64_t taskId, const Task* task = nullptr) {
+        if (!inBatch) {
+            logMutation(op, taskId, task);
+            return;
         }
+        if (batchSnapshot) {
+            return;
+        }
+        string payload = logPayload(op, taskId, task);
+        put_u32(batchLog, static_cast<uint32_t>(payload.size()));
+        batchLog += payload;
+        batchRecords++;
+        if (batchLog.size() > BATCH_SNAPSHOT_THRESHOLD) {
+            batchSnapshot = true;
+            string().swap(batchLog);
+            tasks.suspendIndexes();
+        }
+    }
 
-        int year = stoi(date.substr(0, 4));
-        int month = stoi(date.substr(5, 2));
-        int day = stoi(date.substr(8, 2));
+    // Task ID as shown in the task list to a row number
+    bool parseTaskId(const string& text, size_t& row) const {
+        size_t id;
+        return parse_number(text.data(), text.size(), id) && tasks.find(id, row);
+    }
+
+
+    // Print rows as a task table, one page at a time; longer lists prompt
+    // for the next page or a page number. Given picked, the prompt instead
+    // takes a task ID, which ends paging and is handed back in picked
+    void showPages(const vector<uint32_t>& rows, bool withCreated, string* picked = nullptr) const {
+        TaskTable table(tasks, withCreated);
+        size_t pages = (rows.size() + PAGE_SIZE - 1) / PAGE_SIZE;
+        size_t page = 0;
+        while (true) {
+            table.render(rows, page * PAGE_SIZE, PAGE_SIZE, cout);
+            if (pages <= 1) {
+                return;
+            }
 
-        if (year < 2023 || year > 2100) return false;
-        if (month < 1 || month > 12) return false;
-        if (day < 1 || day > 31) return false;
+            cout << "Page " << page + 1 << " of " << pages << " (" << rows.size() << " tasks). "
+                 << (picked ? "Press Enter for the next page, enter a task ID, or q to stop: "
+                            : "Press Enter for the next page, enter a page number, or q to stop: ");
+            string input;
+            if (!getline(cin, input) || input == "q") {
+                return;
+            }
+            size_t number;
+            if (input.empty()) {
+                if (++page == pages) return;
+            } else if (picked) {
+                *picked = input;
+                return;
+            } else if (parse_number(input.data(), input.size(), number) && number >= 1 && number <= pages) {
+                page = number - 1;
+            } else {
+                cout << "Invalid page." << endl;
+            }
+        }
+    }
 
-        if ((month == 4 || month == 6 || month == 9 || month == 11) && day > 30) return false;
-        if (month == 2) {
-            bool isLeap = (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
-            if (day > (isLeap ? 29 : 28)) return false;
+    bool checkDescription(const string& description, string& error) const {
+        if (description.empty()) {
+            error = "task description cannot be empty";
+            return false;
+        }
+        if (description.length() > MAX_DESCRIPTION_LENGTH) {
+            error = "task description too long (max " + to_string(MAX_DESCRIPTION_LENGTH) + " characters)";
+            return false;
         }
+        return true;
+    }
 
+    // Empty text means no due date
+    bool parseDueDate(const string& text, int32_t& day, string& error) {
+        if (text.empty()) {
+            day = DUE_NONE;
+            return true;
+        }
+        if (!isValidDate(text, day)) {
+            error = "invalid due date '" + text + "' (use YYYY-MM-DD)";
+            return false;
+        }
         return true;
     }
 
-    // Get current date in YYYY-MM-DD format
-    string getCurrentDate() const {
-        time_t now = time(0);
-        struct tm* timeinfo = localtime(&now);
-        char buffer[11];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d", timeinfo);
-        return string(buffer);
+    // Validate date format (YYYY-MM-DD) and parse it into a day number
+    bool isValidDate(const string& date, int32_t& day) {
+        if (!parse_date(date.data(), date.size(), day)) return false;
+
+        if (!due_day_supported(day)) return false;
+
+        return true;
     }
 
 public:
-    TaskManager() {
+    TaskManager() : users(USER_FILE), writes(make_shared<PersistQueue>()) {
+        StorageLayout::instance();
         isLoggedIn = false;
         userID = "";
+        logActive = false;
+        logBytes = 0;
+        snapshotGen = 0;
+        diskGen = 0;
+        keptLogFrom = 0;
+        inBatch = false;
+        batchSnapshot = false;
+        batchRecords = 0;
+        listOrder = ORDER_LIST;
+    }
+
+    // Nothing queued is lost at exit
+    ~TaskManager() {
+        flush();
     }
 
     // Create a new user account
@@ -225,22 +4115,7 @@ public:
                 continue;
             }
 
-            ifstream userFile(USER_FILE);
-            string stored_userID;
-            bool exists = false;
-
-            if (userFile.is_open()) {
-                while (userFile >> stored_userID) {
-                    userFile.ignore(numeric_limits<streamsize>::max(), '\n'); // Skip password hash
-                    if (userID == stored_userID) {
-                        exists = true;
-                        break;
-                    }
-                }
-                userFile.close();
-            }
-
-            if (exists) {
+            if (users.exists(userID)) {
                 cout << "User ID already exists. Please choose another one." << endl;
                 continue;
             }
@@ -268,16 +4143,16 @@ public:
             break;
         }
 
-        string hashedPassword = hashPassword(password);
+        string hashedPassword = hash_password(password);
 
-        ofstream userFile(USER_FILE, ios::app);
-        if (userFile.is_open()) {
-            userFile << userID << " " << hashedPassword << endl;
-            userFile.close();
+        if (users.add(userID, hashedPassword)) {
             cout << "Account created successfully!" << endl;
             isLoggedIn = true;
             // start with empty tasks
             tasks.clear();
+            snapshotGen = 0;
+            diskGen = 0;
+            keptLogFrom = 0;
             save_tasks();
             return true;
         } else {
@@ -296,23 +4171,11 @@ public:
         while (attempts < MAX_LOGIN_ATTEMPTS) {
             cout << "Enter User ID: ";
             getline(cin, userID);
-            cout << "Enter Password: ";
-            getline(cin, password);
-
-            ifstream userFile(USER_FILE);
-            if (userFile.is_open()) {
-                string stored_userID, stored_password;
-                bool found = false;
-
-                while (userFile >> stored_userID >> stored_password) {
-                    if (userID == stored_userID && hashPassword(password) == stored_password) {
-                        found = true;
-                        break;
-                    }
-                }
-                userFile.close();
+            cout << "Enter Password: ";
+            getline(cin, password);
 
-                if (found) {
+            if (users.is_available()) {
+                if (users.verify(userID, hash_password(password))) {
                     cout << "Login successful!" << endl;
                     isLoggedIn = true;
                     load_tasks();
@@ -335,6 +4198,7 @@ public:
     // Add a new task
     void add_task() {
         string description, dueDate;
+        int32_t dueDay = DUE_NONE;
         int priorityChoice;
         Priority priority;
 
@@ -365,13 +4229,14 @@ public:
                 break; // No due date is allowed
             }
 
-            if (!isValidDate(dueDate)) {
+            if (!isValidDate(dueDate, dueDay)) {
+                dueDay = DUE_NONE;
                 cout << "Invalid date format. Please use YYYY-MM-DD format." << endl;
                 continue;
             }
 
-            string currentDate = getCurrentDate();
-            if (dueDate < currentDate) {
+            if (dueDay < current_day()) {
+                dueDay = DUE_NONE;
                 cout << "Due date must be today or in the future." << endl;
                 continue;
             }
@@ -402,15 +4267,14 @@ public:
             break;
         }
 
-        Task newTask(description, dueDate, priority);
-        tasks.push_back(newTask);
+        Task newTask(description, dueDay, priority);
+        insert_task(newTask);
 
         cout << "Task added successfully!" << endl;
-        save_tasks();
     }
 
-    // View all tasks
-    void view_tasks() const {
+    // View all tasks; see showPages() for picked
+    void view_tasks(string* picked = nullptr) const {
         cout << "\n=== Your Tasks ===" << endl;
 
         if (tasks.empty()) {
@@ -418,26 +4282,39 @@ public:
             return;
         }
 
-        cout << left << setw(5) << "ID"
-             << setw(30) << "Description"
-             << setw(12) << "Due Date"
-             << setw(10) << "Priority"
-             << setw(15) << "Status"
-             << setw(12) << "Created" << endl;
-        cout << string(84, '-') << endl;
+        vector<uint32_t> rows;
+        tasks.orderedRows(listOrder, rows);
+        showPages(rows, true, picked);
+        cout << endl;
+    }
 
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            cout << left << setw(5) << (i + 1)
-                 << setw(30) << (tasks[i].description.length() > 27 ?
-                                 tasks[i].description.substr(0, 27) + "..." :
-                                 tasks[i].description)
-                 << setw(12) << (tasks[i].dueDate.empty() ? "None" : tasks[i].dueDate)
-                 << setw(10) << tasks[i].getPriorityString()
-                 << setw(15) << tasks[i].getStatusString()
-                 << setw(12) << tasks[i].getFormattedDate(tasks[i].createdDate) << endl;
+    // Show the task list and read the ID of the task to act on, either at
+    // a page prompt or after the list
+    bool pick_task(const char* prompt, size_t& row) const {
+        string picked;
+        uint64_t taskId;
+        view_tasks(&picked);
+        if (!picked.empty()) {
+            if (!parse_number(picked.data(), picked.size(), taskId)) {
+                cout << "Invalid input." << endl;
+                return false;
+            }
+        } else {
+            cout << prompt;
+            if (!(cin >> taskId)) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Invalid input." << endl;
+                return false;
+            }
+            cin.ignore();
         }
 
-        cout << endl;
+        if (!tasks.find(taskId, row)) {
+            cout << "Invalid task ID." << endl;
+            return false;
+        }
+        return true;
     }
 
     // View task details
@@ -447,9 +4324,10 @@ public:
             return;
         }
 
-        int taskIndex;
+        uint64_t taskId;
+        size_t row;
         cout << "Enter task ID to view details: ";
-        if (!(cin >> taskIndex)) {
+        if (!(cin >> taskId)) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             cout << "Invalid input." << endl;
@@ -457,17 +4335,17 @@ public:
         }
         cin.ignore();
 
-        if (taskIndex < 1 || taskIndex > static_cast<int>(tasks.size())) {
+        if (!tasks.find(taskId, row)) {
             cout << "Invalid task ID." << endl;
             return;
         }
 
-        const Task& task = tasks[taskIndex - 1];
+        const Task task = tasks.get(row);
 
         cout << "\n=== Task Details ===" << endl;
-        cout << "ID: " << taskIndex << endl;
+        cout << "ID: " << task.id << endl;
         cout << "Description: " << task.description << endl;
-        cout << "Due Date: " << (task.dueDate.empty() ? "None" : task.dueDate) << endl;
+        cout << "Due Date: " << task.getDueDateString() << endl;
         cout << "Priority: " << task.getPriorityString() << endl;
         cout << "Status: " << task.getStatusString() << endl;
         cout << "Created: " << task.getFormattedDate(task.createdDate) << endl;
@@ -486,20 +4364,10 @@ public:
             return;
         }
 
-        int taskIndex, statusChoice;
-
-        view_tasks();
-        cout << "Enter task ID to update status: ";
-        if (!(cin >> taskIndex)) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input." << endl;
-            return;
-        }
-        cin.ignore();
+        size_t row;
+        int statusChoice;
 
-        if (taskIndex < 1 || taskIndex > static_cast<int>(tasks.size())) {
-            cout << "Invalid task ID." << endl;
+        if (!pick_task("Enter task ID to update status: ", row)) {
             return;
         }
 
@@ -521,20 +4389,21 @@ public:
             return;
         }
 
+        Task task = tasks.get(row);
         TaskStatus newStatus = static_cast<TaskStatus>(statusChoice - 1);
-        TaskStatus oldStatus = tasks[taskIndex - 1].status;
+        TaskStatus oldStatus = task.status;
 
-        tasks[taskIndex - 1].status = newStatus;
+        task.status = newStatus;
 
         if (newStatus == COMPLETED && oldStatus != COMPLETED) {
-            tasks[taskIndex - 1].completedDate = time(0);
+            task.completedDate = time(0);
             cout << "Task marked as completed on "
-                 << tasks[taskIndex - 1].getFormattedDate(tasks[taskIndex - 1].completedDate) << endl;
+                 << task.getFormattedDate(task.completedDate) << endl;
         } else {
-            cout << "Task status updated to " << tasks[taskIndex - 1].getStatusString() << endl;
+            cout << "Task status updated to " << task.getStatusString() << endl;
         }
 
-        save_tasks();
+        replace_task(row, task);
     }
 
     // Edit task
@@ -544,30 +4413,19 @@ public:
             return;
         }
 
-        int taskIndex;
-        view_tasks();
-        cout << "Enter task ID to edit: ";
-        if (!(cin >> taskIndex)) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input." << endl;
-            return;
-        }
-        cin.ignore();
-
-        if (taskIndex < 1 || taskIndex > static_cast<int>(tasks.size())) {
-            cout << "Invalid task ID." << endl;
+        size_t row;
+        if (!pick_task("Enter task ID to edit: ", row)) {
             return;
         }
 
-        Task& task = tasks[taskIndex - 1];
+        Task task = tasks.get(row);
         string input;
         int choice;
 
         cout << "\n=== Edit Task ===" << endl;
         cout << "Current details:" << endl;
         cout << "1. Description: " << task.description << endl;
-        cout << "2. Due Date: " << (task.dueDate.empty() ? "None" : task.dueDate) << endl;
+        cout << "2. Due Date: " << task.getDueDateString() << endl;
         cout << "3. Priority: " << task.getPriorityString() << endl;
         cout << "4. Status: " << task.getStatusString() << endl;
 
@@ -608,25 +4466,25 @@ public:
                 getline(cin, input);
 
                 if (input.empty()) {
-                    task.dueDate = "";
+                    task.dueDay = DUE_NONE;
                     cout << "Due date removed." << endl;
                     break;
                 }
 
-                if (!isValidDate(input)) {
-                    cout << "Invalid date format." << endl;
-                    break;
-                }
-
                 {
-                    string currentDate = getCurrentDate();
-                    if (input < currentDate) {
+                    int32_t day;
+                    if (!isValidDate(input, day)) {
+                        cout << "Invalid date format." << endl;
+                        break;
+                    }
+
+                    if (day < current_day()) {
                         cout << "Due date must be today or in the future." << endl;
                         break;
                     }
-                }
 
-                task.dueDate = input;
+                    task.dueDay = day;
+                }
                 cout << "Due date updated." << endl;
                 break;
 
@@ -684,7 +4542,7 @@ public:
                 break;
         }
 
-        save_tasks();
+        replace_task(row, task);
     }
 
     // Remove task
@@ -694,23 +4552,12 @@ public:
             return;
         }
 
-        int taskIndex;
-        view_tasks();
-        cout << "Enter task ID to remove: ";
-        if (!(cin >> taskIndex)) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input." << endl;
-            return;
-        }
-        cin.ignore();
-
-        if (taskIndex < 1 || taskIndex > static_cast<int>(tasks.size())) {
-            cout << "Invalid task ID." << endl;
+        size_t row;
+        if (!pick_task("Enter task ID to remove: ", row)) {
             return;
         }
 
-        cout << "Are you sure you want to remove task \"" << tasks[taskIndex - 1].description << "\"? (y/n): ";
+        cout << "Are you sure you want to remove task \"" << tasks.description(row) << "\"? (y/n): ";
         char confirm;
         cin >> confirm;
         cin.ignore();
@@ -720,9 +4567,8 @@ public:
             return;
         }
 
-        tasks.erase(tasks.begin() + taskIndex - 1);
+        delete_task(row);
         cout << "Task removed successfully." << endl;
-        save_tasks();
     }
 
     // Sort tasks
@@ -747,35 +4593,26 @@ public:
         }
         cin.ignore();
 
+        // Each order is read off an index kept up to date on every change,
+        // so switching only records the choice
         switch (choice) {
-            case 1: // By Due Date
-                sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) {
-                    if (a.dueDate.empty() && b.dueDate.empty()) return false;
-                    if (a.dueDate.empty()) return false;
-                    if (b.dueDate.empty()) return true;
-                    return a.dueDate < b.dueDate;
-                });
+            case 1:
+                listOrder = ORDER_DUE;
                 cout << "Tasks sorted by due date." << endl;
                 break;
 
-            case 2: // By Priority
-                sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) {
-                    return a.priority > b.priority; // High to Low
-                });
+            case 2:
+                listOrder = ORDER_PRIORITY;
                 cout << "Tasks sorted by priority (High to Low)." << endl;
                 break;
 
-            case 3: // By Status
-                sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) {
-                    return a.status < b.status; // Pending to Completed
-                });
+            case 3:
+                listOrder = ORDER_STATUS;
                 cout << "Tasks sorted by status (Pending to Completed)." << endl;
                 break;
 
-            case 4: // By Creation Date
-                sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) {
-                    return a.createdDate > b.createdDate; // Newest to Oldest
-                });
+            case 4:
+                listOrder = ORDER_CREATED;
                 cout << "Tasks sorted by creation date (Newest to Oldest)." << endl;
                 break;
 
@@ -784,6 +4621,7 @@ public:
                 return;
         }
 
+        persist(LOG_ORDER, listOrder);
         view_tasks();
     }
 
@@ -810,7 +4648,7 @@ public:
         }
         cin.ignore();
 
-        vector<Task> filteredTasks;
+        TaskQuery query;
 
         switch (choice) {
             case 1: { // By Status
@@ -828,185 +4666,815 @@ public:
                 }
                 cin.ignore();
 
-                if (statusChoice < 1 || statusChoice > 3) {
-                    cout << "Invalid choice." << endl;
-                    return;
-                }
+                if (statusChoice < 1 || statusChoice > 3) {
+                    cout << "Invalid choice." << endl;
+                    return;
+                }
+
+                TaskStatus status = static_cast<TaskStatus>(statusChoice - 1);
+                query.withStatus(status);
+
+                cout << "Tasks with status ";
+                cout << (status == PENDING ? "Pending" : (status == IN_PROGRESS ? "In Progress" : "Completed")) << ":" << endl;
+                break;
+            }
+
+            case 2: { // By Priority
+                int priorityChoice;
+                cout << "Select priority:" << endl;
+                cout << "1. Low" << endl;
+                cout << "2. Medium" << endl;
+                cout << "3. High" << endl;
+                cout << "Enter choice (1-3): ";
+                if (!(cin >> priorityChoice)) {
+                    cin.clear();
+                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    cout << "Invalid input." << endl;
+                    return;
+                }
+                cin.ignore();
+
+                if (priorityChoice < 1 || priorityChoice > 3) {
+                    cout << "Invalid choice." << endl;
+                    return;
+                }
+
+                Priority priority = static_cast<Priority>(priorityChoice);
+                query.withPriority(priority);
+
+                cout << "Tasks with " << (priority == LOW ? "Low" : (priority == MEDIUM ? "Medium" : "High")) << " priority:" << endl;
+                break;
+            }
+
+            case 3: { // Due Today
+                int32_t today = current_day();
+                query = TaskQuery::dueToday(today);
+
+                cout << "Tasks due today (" << day_to_date(today) << "):" << endl;
+                break;
+            }
+
+            case 4: { // Due This Week
+                int32_t today = current_day();
+                query = TaskQuery::dueThisWeek(today);
+
+                cout << "Tasks due this week (" << day_to_date(today) << " to " << day_to_date(today + 7) << "):" << endl;
+                break;
+            }
+
+            case 5: { // Overdue
+                query = TaskQuery::overdue(current_day());
+
+                cout << "Overdue tasks:" << endl;
+                break;
+            }
+
+            default:
+                cout << "Invalid choice." << endl;
+                return;
+        }
+
+        TaskView matches = query_tasks(query);
+        if (matches.empty()) {
+            cout << "No tasks match the filter criteria." << endl;
+            return;
+        }
+
+        // Shown in the order chosen with Sort Tasks, like the full list
+        tasks.sortRows(listOrder, matches.rows);
+        showPages(matches.rows, false);
+        cout << endl;
+    }
+
+    // Search task descriptions
+    void search_tasks() const {
+        if (tasks.empty()) {
+            cout << "No tasks available." << endl;
+            return;
+        }
+
+        string query;
+        cout << "Enter search words (end a word with * to match its prefix): ";
+        getline(cin, query);
+
+        TaskView matches = search(query);
+        if (matches.empty()) {
+            cout << "No tasks match the search." << endl;
+            return;
+        }
+
+        showPages(matches.rows, false);
+        cout << matches.size() << " matching task(s)." << endl;
+    }
+
+    // Tasks whose description has every word of query, oldest first
+    TaskView search(string_view query) const {
+        MetricTimer timer(METRIC_SEARCH);
+        TaskView view = {&tasks, {}};
+        for (uint64_t taskId : tasks.search(query)) {
+            size_t row;
+            if (tasks.find(taskId, row)) view.rows.push_back(static_cast<uint32_t>(row));
+        }
+        return view;
+    }
+
+    // Run a filter over the current tasks
+    TaskView query_tasks(const TaskQuery& query) const {
+        MetricTimer timer(METRIC_FILTER);
+        return query.run(tasks);
+    }
+
+    // Status, priority and overdue counts for the current tasks, read off
+    // the counts the task store keeps
+    TaskCounts statistics() const {
+        MetricTimer timer(METRIC_STATS);
+        return tasks.counts(current_day());
+    }
+
+    // Get statistics
+    void show_statistics() const {
+        if (tasks.empty()) {
+            cout << "No tasks available." << endl;
+            return;
+        }
+
+        TaskCounts counts = statistics();
+        size_t pending = counts.byStatus[PENDING];
+        size_t inProgress = counts.byStatus[IN_PROGRESS];
+        size_t completed = counts.byStatus[COMPLETED];
+        size_t low = counts.byPriority[LOW];
+        size_t medium = counts.byPriority[MEDIUM];
+        size_t high = counts.byPriority[HIGH];
+        size_t overdue = counts.overdue;
+
+        cout << "\n=== Task Statistics ===" << endl;
+        cout << "Total Tasks: " << tasks.count() << endl;
+        cout << "By Status:" << endl;
+        cout << "  Pending: " << pending << " (" << (pending * 100 / tasks.count()) << "%)" << endl;
+        cout << "  In Progress: " << inProgress << " (" << (inProgress * 100 / tasks.count()) << "%)" << endl;
+        cout << "  Completed: " << completed << " (" << (completed * 100 / tasks.count()) << "%)" << endl;
+        cout << "By Priority:" << endl;
+        cout << "  Low: " << low << " (" << (low * 100 / tasks.count()) << "%)" << endl;
+        cout << "  Medium: " << medium << " (" << (medium * 100 / tasks.count()) << "%)" << endl;
+        cout << "  High: " << high << " (" << (high * 100 / tasks.count()) << "%)" << endl;
+        cout << "Overdue Tasks: " << overdue << endl;
+        cout << endl;
+    }
+
+    // Logout
+    void logout() {
+        close_user();
+        cout << "Logged out successfully." << endl;
+    }
+
+    // Whether the log holds changes that are not in the snapshot yet
+    bool is_dirty() const {
+        return logActive && logBytes > LOG_HEADER_SIZE;
+    }
+
+    // Block until every change made so far is on disk
+    void flush() {
+        writes->flush();
+    }
+
+    // Fold logged changes into a new snapshot so the next load needs no replay
+    void write_back() {
+        if (is_dirty()) {
+            save_tasks();
+        }
+    }
+
+    // Write back, then release the tasks
+    void close_user() {
+        write_back();
+        writes->close();
+        logActive = false;
+        isLoggedIn = false;
+        userID = "";
+        tasks = TaskStore();
+        listOrder = ORDER_LIST;
+    }
+
+    // Approximate heap bytes held by the loaded tasks
+    size_t memory_usage() const {
+        return tasks.memoryUsage();
+    }
+
+    // Check if user is logged in
+    bool is_logged_in() const {
+        return isLoggedIn;
+    }
+
+    // Open an existing account's tasks without prompting, for batch use
+    bool open_user(const string& id) {
+        if (!users.exists(id)) {
+            return false;
+        }
+        open_known_user(id);
+        return true;
+    }
+
+    // Open an account the caller has already checked, without reading the
+    // user file into this manager's own user table
+    void open_known_user(const string& id) {
+        userID = id;
+        isLoggedIn = true;
+        load_tasks();
+    }
+
+    size_t task_count() const {
+        return tasks.count();
+    }
+
+    // Non-interactive task operations on a row; see parseTaskId()
+    void insert_task(const Task& task) {
+        uint64_t taskId = tasks.push_back(task);
+        persist(LOG_ADD, taskId, &task);
+    }
+
+    void replace_task(size_t row, const Task& task) {
+        tasks.set(row, task);
+        persist(LOG_UPDATE, tasks.id[row], &task);
+    }
+
+    void delete_task(size_t row) {
+        uint64_t taskId = tasks.id[row];
+        tasks.erase(row);
+        persist(LOG_DELETE, taskId);
+    }
+
+    // Batches apply changes in memory only and persist them once, on commit:
+    // as one log group, or as a snapshot if they grew too large; see persist()
+    void begin_batch() {
+        inBatch = true;
+        batchSnapshot = false;
+        batchLog.clear();
+        batchRecords = 0;
+    }
+
+    void commit_batch() {
+        inBatch = false;
+        if (batchSnapshot) {
+            tasks.rebuildIndexes();
+            save_tasks();
+        } else if (batchRecords > 0 && !logActive) {
+            save_tasks();
+        } else if (batchRecords > 0) {
+            string payload;
+            put_u8(payload, static_cast<uint8_t>(LOG_GROUP));
+            put_u64(payload, batchRecords);
+            payload += batchLog;
+            appendLogRecord(payload);
+        }
+        string().swap(batchLog);
+        batchRecords = 0;
+        flush();
+    }
+
+    // Drop the batch's changes by reloading what is on disk
+    void rollback_batch() {
+        inBatch = false;
+        string().swap(batchLog);
+        batchRecords = 0;
+        load_tasks();
+    }
+
+    // Stream tasks in and save them with one commit. Nothing is saved if any
+    // record is invalid; the first errors are printed with line numbers.
+    bool import_tasks(istream& in, TaskFormat format, size_t& imported) {
+        unique_ptr<TaskReader> reader = make_task_reader(in, format);
+        reader->strictDates = true;
+
+        begin_batch();
+        Task task;
+        imported = 0;
+        while (reader->next(task)) {
+            insert_task(task);
+            imported++;
+        }
+
+        if (reader->errorCount > 0) {
+            for (const auto& error : reader->errors) {
+                cerr << "Error: " << error << endl;
+            }
+            if (reader->errorCount > reader->errors.size()) {
+                cerr << "... and " << reader->errorCount - reader->errors.size() << " more errors" << endl;
+            }
+            cerr << "No tasks were imported." << endl;
+            rollback_batch();
+            imported = 0;
+            return false;
+        }
+
+        commit_batch();
+        return true;
+    }
+
+    // Write every task in the order the list is shown, through a block-sized buffer
+    bool export_tasks(ostream& out, TaskFormat format) const {
+        string buffer;
+        buffer.reserve(TEXT_READ_BLOCK + 1024);
+        if (format == FORMAT_CSV) {
+            buffer += "description,due_date,priority,status,created,completed\n";
+        }
+        vector<uint32_t> rows;
+        tasks.orderedRows(listOrder, rows);
+        for (uint32_t i : rows) {
+            append_task(buffer, tasks.get(i), format);
+            if (buffer.size() >= TEXT_READ_BLOCK) {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        return static_cast<bool>(out);
+    }
+
+    // Apply one batch command:
+    //   add|<description>|<due date or empty>|<priority>
+    //   status|<task id>|<status>
+    //   edit|<task id>|description|due|priority|status|<value>
+    //   delete|<task id>
+    // Priorities are 1-3 or low/medium/high; statuses are 1-3 or
+    // pending/in-progress/completed. Returns false with a reason in error.
+    bool apply_command(const string& line, string& error) {
+        vector<string> fields;
+        size_t start = 0;
+        while (true) {
+            size_t bar = line.find('|', start);
+            fields.push_back(line.substr(start, bar == string::npos ? string::npos : bar - start));
+            if (bar == string::npos) break;
+            start = bar + 1;
+        }
+        const string& command = fields[0];
+
+        if (command == "add") {
+            if (fields.size() < 2 || fields.size() > 4) {
+                error = "usage: add|<description>|<due date>|<priority>";
+                return false;
+            }
+            Task task;
+            task.description = fields[1];
+            if (!checkDescription(task.description, error)) return false;
+            if (fields.size() > 2 && !parseDueDate(fields[2], task.dueDay, error)) return false;
+            if (fields.size() > 3 && !fields[3].empty() && !parse_priority(fields[3], task.priority)) {
+                error = "invalid priority '" + fields[3] + "'";
+                return false;
+            }
+            insert_task(task);
+            return true;
+        }
+
+        size_t row;
+        if (fields.size() < 2 || !parseTaskId(fields[1], row)) {
+            error = fields.size() < 2 ? "missing task ID" : "invalid task ID '" + fields[1] + "'";
+            return false;
+        }
+
+        if (command == "delete" && fields.size() == 2) {
+            delete_task(row);
+            return true;
+        }
+
+        Task task = tasks.get(row);
+        string field = command == "status" ? "status" : (fields.size() > 2 ? fields[2] : "");
+        size_t valueField = command == "status" ? 2 : 3;
+        if ((command != "status" && command != "edit") || fields.size() != valueField + 1) {
+            error = "unknown or malformed command '" + command + "'";
+            return false;
+        }
+        const string& value = fields[valueField];
+
+        if (field == "description") {
+            if (!checkDescription(value, error)) return false;
+            task.description = value;
+        } else if (field == "due") {
+            if (!parseDueDate(value, task.dueDay, error)) return false;
+        } else if (field == "priority") {
+            if (!parse_priority(value, task.priority)) {
+                error = "invalid priority '" + value + "'";
+                return false;
+            }
+        } else if (field == "status") {
+            TaskStatus status;
+            if (!parse_status(value, status)) {
+                error = "invalid status '" + value + "'";
+                return false;
+            }
+            if (status == COMPLETED && task.status != COMPLETED) {
+                task.completedDate = time(0);
+            }
+            task.status = status;
+        } else {
+            error = "unknown field '" + field + "'";
+            return false;
+        }
+
+        replace_task(row, task);
+        return true;
+    }
+};
+
+// Fixed set of worker threads running queued jobs in FIFO order
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t workers) : stopping(false) {
+        for (size_t i = 0; i < workers; i++) {
+            threads.emplace_back([this] { work(); });
+        }
+    }
+
+    // Runs every queued job before returning
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
 
-                TaskStatus status = static_cast<TaskStatus>(statusChoice - 1);
-                for (const auto& task : tasks) {
-                    if (task.status == status) {
-                        filteredTasks.push_back(task);
-                    }
-                }
+    void submit(function<void()> job) {
+        {
+            lock_guard<mutex> guard(lock);
+            jobs.push_back(move(job));
+        }
+        ready.notify_one();
+    }
 
-                cout << "Tasks with status ";
-                cout << (status == PENDING ? "Pending" : (status == IN_PROGRESS ? "In Progress" : "Completed")) << ":" << endl;
-                break;
+private:
+    vector<thread> threads;
+    deque<function<void()>> jobs;
+    mutex lock;
+    condition_variable ready;
+    bool stopping;
+
+    void work() {
+        while (true) {
+            function<void()> job;
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = move(jobs.front());
+                jobs.pop_front();
             }
+            job();
+        }
+    }
+};
 
-            case 2: { // By Priority
-                int priorityChoice;
-                cout << "Select priority:" << endl;
-                cout << "1. Low" << endl;
-                cout << "2. Medium" << endl;
-                cout << "3. High" << endl;
-                cout << "Enter choice (1-3): ";
-                if (!(cin >> priorityChoice)) {
-                    cin.clear();
-                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-                    cout << "Invalid input." << endl;
-                    return;
-                }
-                cin.ignore();
+// One user's tasks, loaded once and shared by every session of that user.
+// Readers take lock shared, writers exclusive.
+struct UserEntry {
+    shared_mutex lock;
+    TaskManager manager;
+    bool loaded = false; // Guarded by lock
 
-                if (priorityChoice < 1 || priorityChoice > 3) {
-                    cout << "Invalid choice." << endl;
-                    return;
-                }
+    // Guarded by the registry's lock
+    string userID;
+    size_t sessions = 0; // Sessions using the entry; only idle entries are evicted
+    size_t bytes = 0;    // Memory charged to the cache
+    bool evicting = false;
+    list<UserEntry*>::iterator lruPosition;
+    bool inLru = false;
+};
 
-                Priority priority = static_cast<Priority>(priorityChoice);
-                for (const auto& task : tasks) {
-                    if (task.priority == priority) {
-                        filteredTasks.push_back(task);
-                    }
-                }
+// Hit/miss and size counters for the registry's cache
+struct CacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;  // Users currently loaded
+    size_t bytes;
+    size_t budget;
+};
 
-                cout << "Tasks with " << (priority == LOW ? "Low" : (priority == MEDIUM ? "Medium" : "High")) << " priority:" << endl;
-                break;
+// Registry of loaded users for server mode, so a second session for the
+// same user reuses the tasks already in memory. Users nobody is using stay
+// loaded in LRU order until the memory budget is exceeded; evicting a user
+// writes its logged changes back to the snapshot first.
+class TaskRegistry {
+public:
+    explicit TaskRegistry(size_t budgetBytes)
+        : users(USER_FILE), budget(budgetBytes), usedBytes(0), loadedCount(0),
+          hits(0), misses(0), evictions(0) {}
+
+    // Write back every loaded user on shutdown
+    ~TaskRegistry() {
+        for (auto& entry : entries) {
+            if (entry.second->loaded) {
+                entry.second->manager.close_user();
             }
+        }
+    }
 
-            case 3: { // Due Today
-                string currentDate = getCurrentDate();
-                for (const auto& task : tasks) {
-                    if (task.dueDate == currentDate) {
-                        filteredTasks.push_back(task);
-                    }
-                }
+    bool authenticate(const string& userID, const string& password) {
+        lock_guard<mutex> guard(usersLock);
+        return users.verify(userID, hash_password(password));
+    }
 
-                cout << "Tasks due today (" << currentDate << "):" << endl;
-                break;
+    // The user's entry, loading its tasks on a cache miss; nullptr if the user
+    // is unknown. Every successful acquire must be paired with release().
+    shared_ptr<UserEntry> acquire(const string& userID) {
+        // Checked against the one user table every entry shares
+        {
+            lock_guard<mutex> guard(usersLock);
+            if (!users.exists(userID)) {
+                return nullptr;
             }
+        }
 
-            case 4: { // Due This Week
-                string currentDate = getCurrentDate();
-
-                time_t now = time(0);
-                struct tm timeinfo = *localtime(&now);
-                timeinfo.tm_mday += 7;
-                mktime(&timeinfo); // Normalize the date
+        shared_ptr<UserEntry> entry;
+        {
+            lock_guard<mutex> guard(lock);
+            auto& slot = entries[userID];
+            if (!slot) {
+                slot = make_shared<UserEntry>();
+                slot->userID = userID;
+            }
+            entry = slot;
+            entry->sessions++;
+            entry->evicting = false;
+            if (entry->inLru) {
+                lru.erase(entry->lruPosition);
+                entry->inLru = false;
+            }
+        }
 
-                char weekLater[11];
-                strftime(weekLater, sizeof(weekLater), "%Y-%m-%d", &timeinfo);
+        // Load outside the registry lock so other users are not held up
+        unique_lock<shared_mutex> guard(entry->lock);
+        if (entry->loaded) {
+            hits++;
+            return entry;
+        }
+        misses++;
+        entry->manager.open_known_user(userID);
+        entry->loaded = true;
+        size_t bytes = entry->manager.memory_usage();
+        guard.unlock();
+
+        lock_guard<mutex> registryGuard(lock);
+        usedBytes += bytes;
+        entry->bytes = bytes;
+        loadedCount++;
+        return entry;
+    }
 
-                for (const auto& task : tasks) {
-                    if (!task.dueDate.empty() && task.dueDate >= currentDate && task.dueDate <= weekLater) {
-                        filteredTasks.push_back(task);
-                    }
-                }
+    // End a session; writes back the user's changes and evicts idle users
+    // while the cache is over budget
+    void release(const shared_ptr<UserEntry>& entry) {
+        size_t bytes = 0;
+        {
+            unique_lock<shared_mutex> guard(entry->lock);
+            if (entry->loaded) {
+                entry->manager.write_back();
+                bytes = entry->manager.memory_usage();
+            }
+        }
 
-                cout << "Tasks due this week (" << currentDate << " to " << weekLater << "):" << endl;
-                break;
+        {
+            lock_guard<mutex> guard(lock);
+            usedBytes = usedBytes - entry->bytes + bytes;
+            entry->bytes = bytes;
+            if (--entry->sessions == 0) {
+                lru.push_front(entry.get());
+                entry->lruPosition = lru.begin();
+                entry->inLru = true;
             }
+        }
+        trim();
+    }
 
-            case 5: { // Overdue
-                string currentDate = getCurrentDate();
-                for (const auto& task : tasks) {
-                    if (!task.dueDate.empty() && task.dueDate < currentDate && task.status != COMPLETED) {
-                        filteredTasks.push_back(task);
-                    }
-                }
+    // Charge a user's memory as measured after a change; the caller holds
+    // the entry's lock
+    void charge(UserEntry& entry, size_t bytes) {
+        lock_guard<mutex> guard(lock);
+        usedBytes = usedBytes - entry.bytes + bytes;
+        entry.bytes = bytes;
+    }
 
-                cout << "Overdue tasks:" << endl;
-                break;
+    // Evict idle users while the cache is over budget
+    void trim() {
+        vector<shared_ptr<UserEntry>> victims;
+        {
+            lock_guard<mutex> guard(lock);
+
+            // Pick least recently used idle users until enough would be freed
+            size_t freeing = 0;
+            while (usedBytes - freeing > budget && !lru.empty()) {
+                UserEntry* victim = lru.back();
+                lru.pop_back();
+                victim->inLru = false;
+                victim->evicting = true;
+                freeing += victim->bytes;
+                victims.push_back(entries.find(victim->userID)->second);
             }
-
-            default:
-                cout << "Invalid choice." << endl;
-                return;
         }
 
-        if (filteredTasks.empty()) {
-            cout << "No tasks match the filter criteria." << endl;
-            return;
+        for (auto& victim : victims) {
+            unload(victim);
         }
+    }
 
-        cout << left << setw(5) << "ID"
-             << setw(30) << "Description"
-             << setw(12) << "Due Date"
-             << setw(10) << "Priority"
-             << setw(15) << "Status" << endl;
-        cout << string(72, '-') << endl;
+    CacheStats stats() {
+        lock_guard<mutex> guard(lock);
+        return {hits.load(), misses.load(), evictions.load(), loadedCount, usedBytes, budget};
+    }
 
-        for (size_t i = 0; i < filteredTasks.size(); ++i) {
-            cout << left << setw(5) << (i + 1)
-                 << setw(30) << (filteredTasks[i].description.length() > 27 ?
-                                 filteredTasks[i].description.substr(0, 27) + "..." :
-                                 filteredTasks[i].description)
-                 << setw(12) << (filteredTasks[i].dueDate.empty() ? "None" : filteredTasks[i].dueDate)
-                 << setw(10) << filteredTasks[i].getPriorityString()
-                 << setw(15) << filteredTasks[i].getStatusString() << endl;
+private:
+    mutex lock;
+    unordered_map<string, shared_ptr<UserEntry>> entries;
+    list<UserEntry*> lru; // Idle loaded users, most recently used first
+    mutex usersLock;
+    UserStore users;
+    size_t budget;
+    size_t usedBytes;
+    size_t loadedCount;
+    atomic<size_t> hits;
+    atomic<size_t> misses;
+    atomic<size_t> evictions;
+
+    void unload(const shared_ptr<UserEntry>& victim) {
+        unique_lock<shared_mutex> guard(victim->lock);
+        {
+            // A session may have picked the user up again since it was chosen
+            lock_guard<mutex> registryGuard(lock);
+            if (!victim->evicting || !victim->loaded) return;
+            victim->evicting = false;
         }
+        victim->manager.close_user();
+        victim->loaded = false;
+
+        lock_guard<mutex> registryGuard(lock);
+        usedBytes -= victim->bytes;
+        victim->bytes = 0;
+        loadedCount--;
+        evictions++;
+
+        // Forget the user unless a session has picked it up meanwhile
+        if (victim->sessions == 0) {
+            auto found = entries.find(victim->userID);
+            if (found != entries.end() && found->second == victim) {
+                entries.erase(found);
+            }
+        }
+    }
+};
 
-        cout << endl;
+// One client's conversation with the server. Requests are single lines:
+//   login|<user id>|<password>       logout       quit
+//   list[|<status>]                  stats        cache
+//   add|... status|... edit|... delete|...   (as in batch mode)
+// Replies are "OK" or "ERR <reason>"; list replies "OK <n>" followed by n
+// lines of "<task id>|<description>|<due date>|<priority>|<status>|<created>|<completed>".
+class ServerSession {
+public:
+    bool finished; // Set after "quit"
+
+    explicit ServerSession(TaskRegistry& taskRegistry) : finished(false), registry(taskRegistry) {}
+
+    ~ServerSession() {
+        endSession();
     }
 
-    // Get statistics
-    void show_statistics() const {
-        if (tasks.empty()) {
-            cout << "No tasks available." << endl;
-            return;
-        }
+    ServerSession(const ServerSession&) = delete;
+    ServerSession& operator=(const ServerSession&) = delete;
 
-        int pending = 0, inProgress = 0, completed = 0;
-        int low = 0, medium = 0, high = 0;
-        int overdue = 0;
-        string currentDate = getCurrentDate();
+    // Handle one request line, appending the reply to out
+    void handle(const string& line, string& out) {
+        size_t bar = line.find('|');
+        string command = line.substr(0, bar);
 
-        for (const auto& task : tasks) {
-            switch (task.status) {
-                case PENDING: pending++; break;
-                case IN_PROGRESS: inProgress++; break;
-                case COMPLETED: completed++; break;
+        if (command == "quit") {
+            finished = true;
+            out += "OK\n";
+            return;
+        }
+        if (command == "login") {
+            size_t second = bar == string::npos ? string::npos : line.find('|', bar + 1);
+            if (second == string::npos) {
+                out += "ERR usage: login|<user id>|<password>\n";
+                return;
             }
-
-            switch (task.priority) {
-                case LOW: low++; break;
-                case MEDIUM: medium++; break;
-                case HIGH: high++; break;
+            string id = line.substr(bar + 1, second - bar - 1);
+            if (!registry.authenticate(id, line.substr(second + 1))) {
+                out += "ERR invalid user ID or password\n";
+                return;
+            }
+            endSession();
+            entry = registry.acquire(id);
+            out += entry ? "OK\n" : "ERR unable to load tasks\n";
+            return;
+        }
+        if (command == "cache") {
+            CacheStats stats = registry.stats();
+            out += "OK hits=" + to_string(stats.hits) + " misses=" + to_string(stats.misses)
+                 + " evictions=" + to_string(stats.evictions) + " users=" + to_string(stats.entries)
+                 + " bytes=" + to_string(stats.bytes) + " budget=" + to_string(stats.budget) + "\n";
+            return;
+        }
+        if (command == "metrics") {
+            if (!metricsEnabled) {
+                out += "ERR metrics are off; start the server with --metrics\n";
+                return;
+            }
+            vector<string> lines = Metrics::instance().lines();
+            out += "OK " + to_string(lines.size()) + "\n";
+            for (const string& metric : lines) {
+                out += metric + "\n";
             }
+            return;
+        }
+        if (!entry) {
+            out += "ERR not logged in\n";
+            return;
+        }
+        if (command == "logout") {
+            endSession();
+            out += "OK\n";
+            return;
+        }
 
-            if (!task.dueDate.empty() && task.dueDate < currentDate && task.status != COMPLETED) {
-                overdue++;
+        if (command == "search") {
+            if (bar == string::npos) {
+                out += "ERR usage: search|<words>\n";
+                return;
+            }
+            shared_lock<shared_mutex> guard(entry->lock);
+            TaskView view = entry->manager.search(string_view(line).substr(bar + 1));
+            out += "OK " + to_string(view.rows.size()) + "\n";
+            for (uint32_t row : view.rows) {
+                out += to_string(view.store->id[row]) + "|";
+                append_task(out, view.store->get(row), FORMAT_TEXT);
+            }
+            return;
+        }
+        if (command == "list") {
+            TaskQuery query;
+            if (bar != string::npos) {
+                TaskStatus status;
+                if (!parse_status(line.substr(bar + 1), status)) {
+                    out += "ERR invalid status\n";
+                    return;
+                }
+                query.withStatus(status);
+            }
+            shared_lock<shared_mutex> guard(entry->lock);
+            TaskView view = entry->manager.query_tasks(query);
+            out += "OK " + to_string(view.rows.size()) + "\n";
+            for (uint32_t row : view.rows) {
+                out += to_string(view.store->id[row]) + "|";
+                append_task(out, view.store->get(row), FORMAT_TEXT);
             }
+            return;
+        }
+        if (command == "stats") {
+            shared_lock<shared_mutex> guard(entry->lock);
+            TaskCounts counts = entry->manager.statistics();
+            out += "OK total=" + to_string(entry->manager.task_count())
+                 + " pending=" + to_string(counts.byStatus[PENDING])
+                 + " in_progress=" + to_string(counts.byStatus[IN_PROGRESS])
+                 + " completed=" + to_string(counts.byStatus[COMPLETED])
+                 + " low=" + to_string(counts.byPriority[LOW])
+                 + " medium=" + to_string(counts.byPriority[MEDIUM])
+                 + " high=" + to_string(counts.byPriority[HIGH])
+                 + " overdue=" + to_string(counts.overdue) + "\n";
+            return;
         }
 
-        cout << "\n=== Task Statistics ===" << endl;
-        cout << "Total Tasks: " << tasks.size() << endl;
-        cout << "By Status:" << endl;
-        cout << "  Pending: " << pending << " (" << (pending * 100 / tasks.size()) << "%)" << endl;
-        cout << "  In Progress: " << inProgress << " (" << (inProgress * 100 / tasks.size()) << "%)" << endl;
-        cout << "  Completed: " << completed << " (" << (completed * 100 / tasks.size()) << "%)" << endl;
-        cout << "By Priority:" << endl;
-        cout << "  Low: " << low << " (" << (low * 100 / tasks.size()) << "%)" << endl;
-        cout << "  Medium: " << medium << " (" << (medium * 100 / tasks.size()) << "%)" << endl;
-        cout << "  High: " << high << " (" << (high * 100 / tasks.size()) << "%)" << endl;
-        cout << "Overdue Tasks: " << overdue << endl;
-        cout << endl;
+        string error;
+        bool applied;
+        {
+            unique_lock<shared_mutex> guard(entry->lock);
+            applied = entry->manager.apply_command(line, error);
+            if (applied) {
+                registry.charge(*entry, entry->manager.memory_usage());
+            }
+        }
+        if (applied) {
+            out += "OK\n";
+            registry.trim();
+        } else {
+            out += "ERR " + error + "\n";
+        }
     }
 
-    // Logout
-    void logout() {
-        save_tasks();
-        isLoggedIn = false;
-        userID = "";
-        tasks.clear();
-        cout << "Logged out successfully." << endl;
-    }
+private:
+    TaskRegistry& registry;
+    shared_ptr<UserEntry> entry;
 
-    // Check if user is logged in
-    bool is_logged_in() const {
-        return isLoggedIn;
+    void endSession() {
+        if (entry) {
+            registry.release(entry);
+            entry.reset();
+        }
     }
 };
 
@@ -1019,6 +5487,22 @@ void display_main_menu() {
     cout << "Enter your choice: ";
 }
 
+// Hidden menu option 0: what the metrics have counted so far
+void show_metrics() {
+    if (!metricsEnabled) {
+        cout << "Metrics are off; start the program with --metrics to collect them." << endl;
+        return;
+    }
+    cout << "\n=== Metrics ===" << endl;
+    cout << Metrics::instance().report() << endl;
+}
+
+// Printed at exit when the program was started with --metrics
+void dump_metrics() {
+    cerr << "\n=== Metrics ===" << endl;
+    cerr << Metrics::instance().report();
+}
+
 // Display task menu
 void display_task_menu() {
     cout << "\n=== Task Menu ===" << endl;
@@ -1032,10 +5516,385 @@ void display_task_menu() {
     cout << "8. Filter Tasks" << endl;
     cout << "9. Show Statistics" << endl;
     cout << "10. Logout" << endl;
+    cout << "11. Search Tasks" << endl;
     cout << "Enter your choice: ";
 }
 
-int main() {
+// Run batch commands from a file ("-" for stdin) as a single transaction
+int run_batch(TaskManager& manager, const string& path) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file.is_open()) {
+            cerr << "Error: Unable to open " << path << endl;
+            return 1;
+        }
+    }
+    istream& in = path == "-" ? cin : file;
+
+    manager.begin_batch();
+    string line;
+    size_t lineNumber = 0, applied = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        string error;
+        if (!manager.apply_command(line, error)) {
+            cerr << "Error: line " << lineNumber << ": " << error << endl;
+            cerr << "No changes were saved." << endl;
+            manager.rollback_batch();
+            return 1;
+        }
+        applied++;
+    }
+
+    manager.commit_batch();
+    cout << "Applied " << applied << " operations; " << manager.task_count() << " tasks saved." << endl;
+    return 0;
+}
+
+// Import tasks from a file ("-" for stdin) in a single commit
+int run_import(TaskManager& manager, const string& path, TaskFormat format) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path, ios::binary);
+        if (!file.is_open()) {
+            cerr << "Error: Unable to open " << path << endl;
+            return 1;
+        }
+    }
+    istream& in = path == "-" ? cin : file;
+
+    size_t imported;
+    if (!manager.import_tasks(in, format, imported)) {
+        return 1;
+    }
+    cout << "Imported " << imported << " tasks; " << manager.task_count() << " tasks saved." << endl;
+    return 0;
+}
+
+// Export all tasks to a file ("-" for stdout)
+int run_export(TaskManager& manager, const string& path, TaskFormat format) {
+    ofstream file;
+    if (path != "-") {
+        file.open(path, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            cerr << "Error: Unable to open " << path << endl;
+            return 1;
+        }
+    }
+    ostream& out = path == "-" ? cout : file;
+
+    if (!manager.export_tasks(out, format)) {
+        cerr << "Error: Unable to write " << path << endl;
+        return 1;
+    }
+    if (path != "-") {
+        cout << "Exported " << manager.task_count() << " tasks to " << path << "." << endl;
+    }
+    return 0;
+}
+
+// Serve the line protocol on stdin/stdout as a single session
+int run_server_stdin(TaskRegistry& registry) {
+    ServerSession session(registry);
+    string line, reply;
+    while (!session.finished && getline(cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        reply.clear();
+        session.handle(line, reply);
+        cout << reply << flush;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+// Write end of the pipe that wakes the server's poll loop
+int serverWakeFd = -1;
+volatile sig_atomic_t serverStopping = 0;
+
+void wake_server() {
+    char byte = 0;
+    ssize_t ignored = write(serverWakeFd, &byte, 1);
+    (void)ignored;
+}
+
+void stop_server(int) {
+    serverStopping = 1;
+    wake_server();
+}
+
+// A socket client. While busy, a worker owns the session and the socket is
+// not polled, so each client's requests are answered in order.
+struct ServerConnection {
+    int fd;
+    string input;
+    ServerSession session;
+    atomic<bool> busy;
+    bool closing;
+
+    ServerConnection(int socket, TaskRegistry& registry)
+        : fd(socket), session(registry), busy(false), closing(false) {}
+};
+
+bool send_all(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Serve the line protocol on a Unix socket. The main thread polls the
+// sockets; complete request lines are handed to the worker pool.
+int run_server_socket(TaskRegistry& registry, const string& path, size_t workers) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        cerr << "Error: Socket path is too long." << endl;
+        return 1;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listener, 64) < 0) {
+        cerr << "Error: Unable to listen on " << path << ": " << strerror(errno) << endl;
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+
+    int wakePipe[2];
+    if (pipe(wakePipe) < 0) {
+        cerr << "Error: Unable to create wake pipe." << endl;
+        close(listener);
+        return 1;
+    }
+    fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+    serverWakeFd = wakePipe[1];
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+
+    cout << "Serving on " << path << " with " << workers << " workers." << endl;
+
+    unordered_map<int, unique_ptr<ServerConnection>> connections;
+    {
+        ThreadPool pool(workers);
+        vector<pollfd> fds;
+        char buffer[4096];
+
+        while (!serverStopping) {
+            fds.assign({{listener, POLLIN, 0}, {wakePipe[0], POLLIN, 0}});
+            for (auto& entry : connections) {
+                if (!entry.second->busy) {
+                    fds.push_back({entry.first, POLLIN, 0});
+                }
+            }
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                while (read(wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+            }
+            if (fds[0].revents & POLLIN) {
+                int client = accept(listener, nullptr, nullptr);
+                if (client >= 0) {
+                    connections[client].reset(new ServerConnection(client, registry));
+                }
+            }
+
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (!fds[i].revents) continue;
+                ServerConnection& connection = *connections[fds[i].fd];
+                ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+                if (n <= 0) {
+                    connection.closing = true;
+                    continue;
+                }
+                connection.input.append(buffer, static_cast<size_t>(n));
+
+                size_t end = connection.input.rfind('\n');
+                if (end == string::npos) {
+                    if (connection.input.size() > MAX_REQUEST_LENGTH) connection.closing = true;
+                    continue;
+                }
+                string requests = connection.input.substr(0, end + 1);
+                connection.input.erase(0, end + 1);
+
+                connection.busy = true;
+                ServerConnection* target = &connection;
+                pool.submit([target, requests] {
+                    string reply;
+                    size_t start = 0;
+                    while (start < requests.size() && !target->session.finished) {
+                        size_t newline = requests.find('\n', start);
+                        string line = requests.substr(start, newline - start);
+                        start = newline + 1;
+                        if (!line.empty() && line.back() == '\r') line.pop_back();
+                        if (!line.empty()) target->session.handle(line, reply);
+                    }
+                    if (!send_all(target->fd, reply) || target->session.finished) {
+                        shutdown(target->fd, SHUT_RDWR);
+                    }
+                    target->busy = false;
+                    wake_server();
+                });
+            }
+
+            // Drop clients that hung up once no worker is using them
+            for (auto it = connections.begin(); it != connections.end();) {
+                if (it->second->closing && !it->second->busy) {
+                    close(it->first);
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // The pool finishes queued requests before the sockets are closed
+    }
+
+    for (auto& entry : connections) {
+        close(entry.first);
+    }
+    close(listener);
+    unlink(path.c_str());
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    cout << "Server stopped." << endl;
+    return 0;
+}
+#endif
+
+// Run the multi-user server on a Unix socket, or on stdin/stdout for "-"
+int run_server(const string& path, size_t workers, size_t cacheBytes) {
+    TaskRegistry registry(cacheBytes);
+    if (path == "-") {
+        return run_server_stdin(registry);
+    }
+    #ifndef _WIN32
+    return run_server_socket(registry, path, workers);
+    #else
+    cerr << "Error: Socket mode is not supported on this platform; use --serve -" << endl;
+    return 1;
+    #endif
+}
+
+void print_usage(const char* program) {
+    cout << "Usage: " << program << "                          interactive mode" << endl;
+    cout << "       " << program << " --user <id> --batch <file>   apply commands from file (- for stdin)" << endl;
+    cout << "       " << program << " --user <id> --import <file>  import tasks (- for stdin)" << endl;
+    cout << "       " << program << " --user <id> --export <file>  export tasks (- for stdout)" << endl;
+    cout << "       " << program << " --serve <socket> [--workers N] [--cache-mb N]" << endl;
+    cout << "                                       multi-user server (- for stdin)" << endl;
+    cout << "Import and export use --format csv|jsonl|txt, or the file extension." << endl;
+    cout << "Add --metrics to any mode to time operations and print the results at exit." << endl;
+}
+
+// Handle non-interactive command-line modes
+int run_command_line(int argc, char* argv[]) {
+    string user, batchFile, importFile, exportFile, formatName, servePath;
+    size_t workers = max(2u, thread::hardware_concurrency());
+    size_t cacheMegabytes = DEFAULT_CACHE_MB;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--user" && i + 1 < argc) {
+            user = argv[++i];
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchFile = argv[++i];
+        } else if (arg == "--import" && i + 1 < argc) {
+            importFile = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportFile = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            formatName = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            string value = argv[++i];
+            if (!parse_number(value.data(), value.size(), workers) || workers == 0) {
+                cerr << "Error: Invalid worker count " << value << endl;
+                return 1;
+            }
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            string value = argv[++i];
+            if (!parse_number(value.data(), value.size(), cacheMegabytes)) {
+                cerr << "Error: Invalid cache size " << value << endl;
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if (!servePath.empty()) {
+        return run_server(servePath, workers, cacheMegabytes << 20);
+    }
+
+    int modes = !batchFile.empty() + !importFile.empty() + !exportFile.empty();
+    if (user.empty() || modes != 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const string& file = !importFile.empty() ? importFile : exportFile;
+    TaskFormat format = format_for_path(file);
+    if (!formatName.empty() && !parse_format(formatName, format)) {
+        cerr << "Error: Unknown format " << formatName << endl;
+        return 1;
+    }
+
+    TaskManager manager;
+    if (!manager.open_user(user)) {
+        cerr << "Error: Unknown user " << user << endl;
+        return 1;
+    }
+    if (!importFile.empty()) {
+        return run_import(manager, importFile, format);
+    }
+    if (!exportFile.empty()) {
+        return run_export(manager, exportFile, format);
+    }
+    return run_batch(manager, batchFile);
+}
+
+#ifndef TODO_LIST_NO_MAIN
+int main(int argc, char* argv[]) {
+    // --metrics works with every mode, so it is taken out before the rest
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--metrics") {
+            metricsEnabled = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    if (metricsEnabled) {
+        Metrics::instance();
+        atexit(dump_metrics);
+    }
+
+    // Set up the storage directories once, before anything is loaded
+    if (!StorageLayout::instance().ready()) {
+        return 1;
+    }
+
+    if (argc > 1) {
+        return run_command_line(argc, argv);
+    }
+
     TaskManager manager;
     int choice;
 
@@ -1061,8 +5920,12 @@ int main() {
                     manager.login();
                     break;
                 case 3:
+                    manager.flush();
                     cout << "Thank you for using To-Do List Manager. Goodbye!" << endl;
                     return 0;
+                case 0:
+                    show_metrics();
+                    break;
                 default:
                     cout << "Invalid choice. Please try again." << endl;
                     break;
@@ -1108,6 +5971,12 @@ int main() {
                 case 10:
                     manager.logout();
                     break;
+                case 11:
+                    manager.search_tasks();
+                    break;
+                case 0:
+                    show_metrics();
+                    break;
                 default:
                     cout << "Invalid choice. Please try again." << endl;
                     break;
@@ -1117,3 +5986,4 @@ int main() {
 
     return 0;
 }
+#endif
@@ -0,0 +1,727 @@
+// Benchmarks for the To-Do List Manager
+// Build: g++ -std=c++17 -O2 benchmark.cpp -o benchmark -pthread
+// Run:   ./benchmark [task count]
+//        ./benchmark --suite [--scales 1k,100k,1m] [--json results.json]
+
+#define TODO_LIST_NO_MAIN
+#include "To_DO_LIST.cpp"
+
+#include <chrono>
+#include <random>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+const string BENCH_FILE = "bench_tasks.txt";
+
+// Write a pipe-delimited task file with count tasks
+void generate_text_file(const string& path, size_t count) {
+    ofstream outFile(path);
+    outFile << "#TDL|1\n";
+    for (size_t i = 0; i < count; i++) {
+        outFile << "Benchmark task number " << i << " with some text|"
+                << (i % 3 == 0 ? "" : "2030-06-15") << "|"
+                << (i % 3 + 1) << "|" << (i % 3) << "|"
+                << (1700000000 + i) << "|" << (i % 3 == 2 ? 1700100000 + i : 0) << "\n";
+    }
+}
+
+// Task as it was before due dates became day numbers, for the baselines
+struct LegacyTask {
+    string description;
+    string dueDate;
+    Priority priority;
+    TaskStatus status;
+    time_t createdDate;
+    time_t completedDate;
+};
+
+// The original getline/stringstream loader, kept as the baseline
+size_t parse_with_getline(const string& path, vector<LegacyTask>& tasks) {
+    ifstream inFile(path);
+    string line;
+    while (getline(inFile, line)) {
+        vector<string> parts;
+        stringstream ss(line);
+        string part;
+        while (getline(ss, part, '|')) {
+            parts.push_back(part);
+        }
+
+        if (parts.size() >= 6) {
+            LegacyTask task;
+            task.description = parts[0];
+            task.dueDate = parts[1];
+            task.priority = static_cast<Priority>(stoi(parts[2]));
+            task.status = static_cast<TaskStatus>(stoi(parts[3]));
+            task.createdDate = stoll(parts[4]);
+            task.completedDate = stoll(parts[5]);
+            tasks.push_back(task);
+        }
+    }
+    return tasks.size();
+}
+
+size_t parse_with_reader(const string& path, vector<Task>& tasks) {
+    ifstream inFile(path, ios::binary);
+    TextTaskReader reader(inFile);
+    Task task;
+    while (reader.next(task)) {
+        tasks.push_back(move(task));
+    }
+    return tasks.size();
+}
+
+// Best wall time in milliseconds over a few runs
+template <typename Fn>
+double time_best(Fn fn, int runs = 3) {
+    double best = numeric_limits<double>::max();
+    for (int i = 0; i < runs; i++) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+void bench_parse(size_t count) {
+    cout << "== Text parsing (" << count << " tasks) ==" << endl;
+    generate_text_file(BENCH_FILE, count);
+
+    size_t parsed = 0;
+    double baseline = time_best([&] {
+        vector<LegacyTask> tasks;
+        parsed = parse_with_getline(BENCH_FILE, tasks);
+    });
+    cout << "getline/stringstream: " << fixed << setprecision(1) << baseline << " ms ("
+         << parsed << " tasks)" << endl;
+
+    double reader = time_best([&] {
+        vector<Task> tasks;
+        parsed = parse_with_reader(BENCH_FILE, tasks);
+    });
+    cout << "TextTaskReader:       " << reader << " ms (" << parsed << " tasks)" << endl;
+    cout << "Speedup:              " << setprecision(2) << baseline / reader << "x" << endl;
+
+    remove(BENCH_FILE.c_str());
+}
+
+// The original per-Task statistics loop with string date compares
+size_t count_with_task_loop(const vector<LegacyTask>& tasks, const string& currentDate) {
+    int pending = 0, inProgress = 0, completed = 0;
+    int low = 0, medium = 0, high = 0;
+    int overdue = 0;
+    for (const auto& task : tasks) {
+        switch (task.status) {
+            case PENDING: pending++; break;
+            case IN_PROGRESS: inProgress++; break;
+            case COMPLETED: completed++; break;
+        }
+        switch (task.priority) {
+            case LOW: low++; break;
+            case MEDIUM: medium++; break;
+            case HIGH: high++; break;
+        }
+        if (!task.dueDate.empty() && task.dueDate < currentDate && task.status != COMPLETED) {
+            overdue++;
+        }
+    }
+    return pending + inProgress + completed + low + medium + high + overdue;
+}
+
+size_t checksum(const TaskCounts& c) {
+    return c.byStatus[0] + c.byStatus[1] + c.byStatus[2] +
+           c.byPriority[1] + c.byPriority[2] + c.byPriority[3] + c.overdue;
+}
+
+void report_rate(const string& name, double ms, size_t count, size_t check) {
+    cout << name << fixed << setprecision(2) << ms << " ms, "
+         << setprecision(0) << (count / (ms / 1000.0)) << " tasks/s (check " << check << ")" << endl;
+}
+
+void bench_statistics(size_t count) {
+    cout << "== Statistics (" << count << " tasks) ==" << endl;
+    vector<LegacyTask> tasks(count);
+    vector<uint8_t> status(count), priority(count);
+    vector<int32_t> due(count);
+    int32_t today = days_from_civil(2030, 1, 1);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        status[i] = static_cast<uint8_t>((seed >> 8) % 3);
+        priority[i] = static_cast<uint8_t>((seed >> 12) % 3 + 1);
+        due[i] = (seed >> 16) % 5 == 0 ? DUE_NONE : today - 100 + static_cast<int32_t>((seed >> 18) % 200);
+        tasks[i].status = static_cast<TaskStatus>(status[i]);
+        tasks[i].priority = static_cast<Priority>(priority[i]);
+        tasks[i].dueDate = day_to_date(due[i]);
+    }
+
+    size_t check = 0;
+    double ms = time_best([&] { check = count_with_task_loop(tasks, "2030-01-01"); });
+    report_rate("vector<Task> loop: ", ms, count, check);
+
+    ms = time_best([&] { check = checksum(count_tasks_scalar(status.data(), priority.data(), due.data(), count, today)); });
+    report_rate("scalar kernel:     ", ms, count, check);
+
+    #ifdef TODO_LIST_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        ms = time_best([&] { check = checksum(count_tasks_avx2(status.data(), priority.data(), due.data(), count, today)); });
+        report_rate("AVX2 kernel:       ", ms, count, check);
+    }
+    #endif
+
+    // What show_statistics reads now: counts kept by the store, with the
+    // overdue count last moved a week ago
+    TaskStore store;
+    for (size_t i = 0; i < count; i++) {
+        Task task;
+        task.status = static_cast<TaskStatus>(status[i]);
+        task.priority = static_cast<Priority>(priority[i]);
+        task.dueDay = due[i];
+        store.append(task);
+    }
+    store.rebuildIndexes();
+    store.advanceOverdue(today - 7);
+    ms = time_best([&] { check = checksum(store.counts(today)); });
+    report_rate("maintained counts: ", ms, count, check);
+}
+
+// Log record the size of a typical logged edit
+string sample_record(size_t i) {
+    string payload;
+    put_u8(payload, LOG_ADD);
+    put_u64(payload, i + 1);
+    put_u8(payload, HIGH);
+    put_u8(payload, PENDING);
+    put_u64(payload, 1700000000 + i);
+    put_u64(payload, 0);
+    put_u32(payload, days_from_civil(2030, 6, 15));
+    put_str(payload, "Benchmark task number " + to_string(i));
+    string record;
+    put_u32(record, static_cast<uint32_t>(payload.size()));
+    put_u32(record, crc32(payload.data(), payload.size()));
+    return record + payload;
+}
+
+// Cost of durable saves: what an edit pays on the calling thread, how long a
+// flush takes, and atomic snapshot writes, each with and without fsync
+void bench_persistence(size_t edits, size_t snapshotTasks) {
+    cout << "== Persistence (" << edits << " edits, " << snapshotTasks << "-task snapshot) ==" << endl;
+    const string logPath = "bench_persist.log";
+    const string snapshotPath = "bench_persist.bin";
+    vector<string> records;
+    for (size_t i = 0; i < edits; i++) {
+        records.push_back(sample_record(i));
+    }
+    string snapshot(snapshotTasks * (SNAPSHOT_RECORD_SIZE + 30), 'x');
+
+    for (bool sync : {false, true}) {
+        syncWrites = sync;
+        const char* mode = sync ? "fsync   " : "no fsync";
+
+        auto queue = make_shared<PersistQueue>();
+        remove(logPath.c_str());
+        auto start = chrono::steady_clock::now();
+        for (const auto& record : records) {
+            queue->append(logPath, record);
+        }
+        chrono::duration<double, micro> enqueue = chrono::steady_clock::now() - start;
+        queue->flush();
+        chrono::duration<double, milli> total = chrono::steady_clock::now() - start;
+        cout << mode << " edits:    " << fixed << setprecision(3) << enqueue.count() / edits
+             << " us/edit on the caller, " << setprecision(1) << total.count() << " ms until durable" << endl;
+
+        // Edits arriving one at a time, each flushed (the worst case for fsync)
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < 100; i++) {
+            queue->append(logPath, records[i % records.size()]);
+            queue->flush();
+        }
+        chrono::duration<double, milli> flushed = chrono::steady_clock::now() - start;
+        cout << mode << " flush:    " << setprecision(3) << flushed.count() / 100 << " ms per flushed edit" << endl;
+
+        double ms = time_best([&] { write_file_atomic(snapshotPath, snapshot); });
+        cout << mode << " snapshot: " << setprecision(1) << ms << " ms" << endl;
+    }
+    syncWrites = true;
+    remove(logPath.c_str());
+    remove(snapshotPath.c_str());
+}
+
+// Filters and list orders over one large store with 1, 4 and 16 threads.
+// Every run must return the same rows as the single-threaded one. Smaller
+// stores never use threads, so the count is raised to the threshold.
+void bench_parallel(size_t count) {
+    if (count < PARALLEL_THRESHOLD) {
+        cout << "Warning: " << count << " tasks is below the " << PARALLEL_THRESHOLD
+             << " at which scans use threads; timing " << PARALLEL_THRESHOLD << " instead" << endl;
+        count = PARALLEL_THRESHOLD;
+    }
+    cout << "== Parallel scans and sorts (" << count << " tasks) ==" << endl;
+    TaskStore store;
+    int32_t today = days_from_civil(2030, 1, 1);
+    uint32_t seed = 12345;
+    Task task;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        task.description = "Task " + to_string(i);
+        task.status = static_cast<TaskStatus>((seed >> 8) % 3);
+        task.priority = static_cast<Priority>((seed >> 12) % 3 + 1);
+        task.dueDay = (seed >> 16) % 5 == 0 ? DUE_NONE : today - 100 + static_cast<int32_t>((seed >> 18) % 200);
+        task.createdDate = 1700000000 + (seed >> 4) % 100000000;
+        store.append(task);
+    }
+
+    const size_t savedThreads = parallelThreads;
+    vector<uint32_t> expected[3];
+    for (size_t threads : {1, 4, 16}) {
+        parallelThreads = threads;
+        vector<uint32_t> rows[3];
+        double rebuild = time_best([&] { store.rebuildIndexes(); });
+        double filter = time_best([&] { rows[0] = TaskQuery().withStatus(PENDING).withPriority(HIGH).run(store).rows; });
+        double overdue = time_best([&] { rows[1] = TaskQuery::overdue(today).run(store).rows; });
+        double ordered = time_best([&] { rows[2].clear(); store.orderedRows(ORDER_DUE, rows[2]); });
+        bool same = true;
+        for (int k = 0; k < 3; k++) {
+            if (threads == 1) expected[k] = rows[k];
+            same = same && rows[k] == expected[k];
+        }
+        cout << setw(2) << threads << " threads: " << fixed << setprecision(1)
+             << "index rebuild " << rebuild << " ms, status filter " << filter
+             << " ms, overdue filter " << overdue << " ms, due order " << ordered << " ms"
+             << (same ? "" : " (MISMATCH)") << endl;
+    }
+    parallelThreads = savedThreads;
+}
+
+// Resident set size in MB (Linux only; 0 elsewhere)
+double resident_mb() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1 << 20);
+}
+
+// Give freed memory back to the OS so the next RSS reading starts clean
+void release_free_memory() {
+    #ifdef __GLIBC__
+    malloc_trim(0);
+    #endif
+}
+
+// One std::string per description (the old column) against the text heap,
+// filled the way a snapshot load does, with the sizes known up front
+void bench_descriptions(size_t count) {
+    cout << "== Description storage (" << count << " tasks) ==" << endl;
+    vector<Task> source(count);
+    size_t textBytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        source[i].description = "Benchmark task number " + to_string(i) + " with a longer description";
+        textBytes += source[i].description.size();
+    }
+    release_free_memory();
+
+    double base = resident_mb();
+    vector<string> strings;
+    double load = time_best([&] {
+        vector<string>().swap(strings);
+        strings.reserve(count);
+        for (const auto& task : source) strings.push_back(task.description);
+    });
+    double rss = resident_mb() - base;
+    double release = time_best([&] { vector<string>().swap(strings); }, 1);
+    cout << "vector<string>: load " << fixed << setprecision(1) << load << " ms, +"
+         << rss << " MB resident, release " << release << " ms" << endl;
+    release_free_memory();
+
+    // The layout TaskStore uses: spans into one growing buffer
+    base = resident_mb();
+    vector<TextSpan> spans;
+    string heap;
+    load = time_best([&] {
+        vector<TextSpan>().swap(spans);
+        string().swap(heap);
+        spans.reserve(count);
+        heap.reserve(textBytes);
+        for (const auto& task : source) {
+            spans.push_back({static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(task.description.size())});
+            heap += task.description;
+        }
+    });
+    rss = resident_mb() - base;
+    release = time_best([&] {
+        vector<TextSpan>().swap(spans);
+        string().swap(heap);
+    }, 1);
+    cout << "text heap:      load " << load << " ms, +" << rss << " MB resident, release "
+         << release << " ms" << endl;
+}
+
+// ---- Suite: TaskManager operations over generated accounts ----
+
+// Words for generated descriptions; earlier words are drawn more often
+const char* const SUITE_WORDS[] = {
+    "call", "email", "review", "report", "meeting", "update", "fix", "plan",
+    "team", "client", "budget", "draft", "send", "check", "order", "book",
+    "project", "invoice", "release", "notes", "bank", "doctor", "groceries", "car",
+    "design", "deploy", "backup", "schedule", "slides", "contract", "renew", "pay",
+    "insurance", "taxes", "garden", "repair", "laptop", "server", "website", "blog",
+    "interview", "training", "survey", "feedback", "proposal", "roadmap", "audit", "migrate",
+};
+const char* const SUITE_PASSWORD = "benchpass";
+
+struct SuiteOptions {
+    vector<size_t> scales = {1000, 10000, 100000, 1000000};
+    size_t users = 10000;  // Accounts in the user file for the login lookups
+    int runs = 3;
+    string dir = "bench_data";
+    string jsonPath;       // "-" for stdout
+    bool keep = false;     // Leave the generated files for another run
+};
+
+struct SuiteResult {
+    string name;
+    string sizeKey;  // "tasks" or "users"
+    size_t size;
+    double ms;
+};
+
+// Skewed like a real list: mostly low priority and completed work, due
+// dates bunched around today, a few popular words in most descriptions
+class TaskGenerator {
+public:
+    explicit TaskGenerator(uint64_t seed)
+        : random(seed),
+          priority({50, 35, 15}),
+          status({30, 10, 60}),
+          words(zipfWords()),
+          wordCount(3, 7) {}
+
+    Task next(int32_t today, time_t now) {
+        Task task;
+        task.description.clear();
+        for (int i = wordCount(random); i > 0; i--) {
+            if (!task.description.empty()) task.description += ' ';
+            task.description += SUITE_WORDS[words(random)];
+        }
+        task.description += " #" + to_string(random() % 100000);
+
+        task.priority = static_cast<Priority>(priority(random) + 1);
+        task.status = static_cast<TaskStatus>(status(random));
+        // A quarter have no due date; past due dates are a month back on
+        // average, future ones two weeks ahead
+        uint64_t roll = random() % 100;
+        if (roll < 25) {
+            task.dueDay = DUE_NONE;
+        } else if (roll < 55) {
+            task.dueDay = today - static_cast<int32_t>(exponential(30.0));
+        } else {
+            task.dueDay = today + static_cast<int32_t>(exponential(14.0));
+        }
+        task.createdDate = now - static_cast<time_t>(random() % (2 * 365 * 86400));
+        task.completedDate = task.status == COMPLETED
+            ? task.createdDate + static_cast<time_t>(exponential(5.0 * 86400))
+            : 0;
+        return task;
+    }
+
+private:
+    mt19937_64 random;
+    discrete_distribution<int> priority;
+    discrete_distribution<int> status;
+    discrete_distribution<size_t> words;
+    uniform_int_distribution<int> wordCount;
+
+    double exponential(double mean) {
+        return exponential_distribution<double>(1.0 / mean)(random);
+    }
+
+    // Zipf weights: the r-th word is drawn with weight 1/r
+    static discrete_distribution<size_t> zipfWords() {
+        vector<double> weights;
+        for (size_t r = 1; r <= size(SUITE_WORDS); r++) {
+            weights.push_back(1.0 / r);
+        }
+        return discrete_distribution<size_t>(weights.begin(), weights.end());
+    }
+};
+
+// Discards whatever the interactive functions print
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Run an interactive TaskManager function on scripted input with its
+// output discarded; the best of runs, as time_best
+template <typename Fn>
+double time_interactive(const string& input, Fn fn, int runs) {
+    NullBuffer sink;
+    streambuf* savedIn = cin.rdbuf();
+    streambuf* savedOut = cout.rdbuf(&sink);
+    double ms = time_best([&] {
+        istringstream script(input);
+        cin.rdbuf(script.rdbuf());
+        cin.clear();
+        fn();
+        cin.rdbuf(savedIn);
+    }, runs);
+    cout.rdbuf(savedOut);
+    cin.clear();
+    return ms;
+}
+
+// Parse "5000", "100k" or "10m"
+bool parse_scale(string text, size_t& count) {
+    size_t multiplier = 1;
+    if (!text.empty() && (text.back() == 'k' || text.back() == 'K')) multiplier = 1000;
+    if (!text.empty() && (text.back() == 'm' || text.back() == 'M')) multiplier = 1000000;
+    if (multiplier != 1) text.pop_back();
+    if (!parse_number(text.data(), text.size(), count) || count == 0) {
+        return false;
+    }
+    count *= multiplier;
+    return true;
+}
+
+// Append synthetic accounts to the user file
+void generate_users(size_t count) {
+    ofstream userFile(USER_FILE, ios::app);
+    string hash = hash_password(SUITE_PASSWORD);
+    for (size_t i = 0; i < count; i++) {
+        userFile << "user" << i << " " << hash << "\n";
+    }
+}
+
+// Create the account for a scale and fill it with count generated tasks,
+// unless a kept run already did
+bool generate_account(const string& userID, size_t count, ostream& progress) {
+    TaskManager manager;
+    if (manager.open_user(userID)) {
+        if (manager.task_count() == count) {
+            progress << "  reusing " << userID << endl;
+            return true;
+        }
+        cerr << "Error: " << userID << " has " << manager.task_count() << " tasks, expected "
+             << count << "; remove the data directory and run again." << endl;
+        return false;
+    }
+    ofstream(USER_FILE, ios::app) << userID << " " << hash_password(SUITE_PASSWORD) << "\n";
+    if (!manager.open_user(userID)) {
+        cerr << "Error: Unable to create " << userID << endl;
+        return false;
+    }
+
+    TaskGenerator generator(count);
+    int32_t today = current_day();
+    time_t now = time(0);
+    manager.begin_batch();
+    for (size_t i = 0; i < count; i++) {
+        manager.insert_task(generator.next(today, now));
+    }
+    manager.commit_batch();
+    return true;
+}
+
+// Time every user-facing operation on one generated account
+void run_scale(size_t count, const SuiteOptions& options, vector<SuiteResult>& results, ostream& progress) {
+    string userID = "bench" + to_string(count);
+    progress << "== " << count << " tasks ==" << endl;
+    double ms = time_best([&] {
+        if (!generate_account(userID, count, progress)) exit(1);
+    }, 1);
+    auto record = [&](const string& name, double value) {
+        results.push_back({name, "tasks", count, value});
+        progress << "  " << left << setw(34) << name << right << fixed << setprecision(3)
+                 << value << " ms" << endl;
+    };
+    record("generate", ms);
+
+    TaskManager manager;
+    manager.open_user(userID);
+    record("load_tasks", time_best([&] {
+        manager.close_user();
+        manager.open_user(userID);
+    }, options.runs));
+
+    // Saving folds the log into a new snapshot, so each run makes one edit
+    // first; the flush makes it a durable save
+    double save = numeric_limits<double>::max();
+    string error;
+    for (int i = 0; i < options.runs; i++) {
+        manager.apply_command(i % 2 ? "status|1|pending" : "status|1|completed", error);
+        save = min(save, time_best([&] {
+            manager.write_back();
+            manager.flush();
+        }, 1));
+    }
+    record("save_tasks", save);
+
+    const pair<const char*, const char*> sorts[] = {
+        {"due", "1"}, {"priority", "2"}, {"status", "3"}, {"created", "4"}};
+    for (const auto& sort : sorts) {
+        record(string("sort_tasks.") + sort.first,
+               time_interactive(string(sort.second) + "\nq\n", [&] { manager.sort_tasks(); }, options.runs));
+    }
+
+    const pair<const char*, const char*> filters[] = {
+        {"status.pending", "1\n1"}, {"status.in_progress", "1\n2"}, {"status.completed", "1\n3"},
+        {"priority.low", "2\n1"}, {"priority.medium", "2\n2"}, {"priority.high", "2\n3"},
+        {"due_today", "3"}, {"due_this_week", "4"}, {"overdue", "5"}};
+    for (const auto& filter : filters) {
+        record(string("filter_tasks.") + filter.first,
+               time_interactive(string(filter.second) + "\nq\n", [&] { manager.filter_tasks(); }, options.runs));
+    }
+
+    record("show_statistics", time_interactive("", [&] { manager.show_statistics(); }, options.runs));
+    manager.close_user();
+}
+
+// The first lookup with a fresh store (it read the whole user file in
+// older releases, hence the result name), then one verify per account
+void run_login(size_t users, int runs, vector<SuiteResult>& results, ostream& progress) {
+    string hash = hash_password(SUITE_PASSWORD);
+    double index = time_best([&] {
+        UserStore store(USER_FILE);
+        store.exists("user0");
+    }, runs);
+
+    UserStore store(USER_FILE);
+    size_t verified = 0;
+    double lookups = time_best([&] {
+        verified = 0;
+        for (size_t i = 0; i < users; i++) {
+            verified += store.verify("user" + to_string(i), hash);
+        }
+    }, runs);
+    if (verified != users) {
+        cerr << "Error: only " << verified << " of " << users << " accounts verified" << endl;
+    }
+
+    progress << "== Login (" << users << " accounts) ==" << endl;
+    results.push_back({"login.read_user_file", "users", users, index});
+    results.push_back({"login.lookup", "users", users, lookups / users});
+    progress << "  first lookup: " << fixed << setprecision(3) << index << " ms, lookup: "
+             << lookups / users * 1e6 << " ns" << endl;
+}
+
+string iso_timestamp(time_t when) {
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", gmtime(&when));
+    return text;
+}
+
+// One object per run; results are flat so runs can be diffed by name and size
+string suite_json(const SuiteOptions& options, const vector<SuiteResult>& results) {
+    ostringstream out;
+    out << "{\n  \"suite\": \"todo-list\",\n  \"version\": 1,\n"
+        << "  \"timestamp\": \"" << iso_timestamp(time(0)) << "\",\n"
+        << "  \"threads\": " << parallelThreads << ",\n"
+        << "  \"runs\": " << options.runs << ",\n"
+        << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const SuiteResult& result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << "\", \""
+            << result.sizeKey << "\": " << result.size << ", \"ms\": "
+            << setprecision(6) << result.ms << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+int run_suite(const SuiteOptions& options) {
+    ostream& progress = options.jsonPath == "-" ? cerr : cout;
+    error_code ec;
+    bool created = filesystem::create_directories(options.dir, ec);
+    filesystem::path home = filesystem::current_path();
+    filesystem::current_path(options.dir, ec);
+    if (ec) {
+        cerr << "Error: Unable to use " << options.dir << ": " << ec.message() << endl;
+        return 1;
+    }
+    if (!StorageLayout::instance().ready()) {
+        return 1;
+    }
+
+    if (!UserStore(USER_FILE).exists("user0")) {
+        generate_users(options.users);
+    }
+    vector<SuiteResult> results;
+    run_login(options.users, options.runs, results, progress);
+    for (size_t count : options.scales) {
+        run_scale(count, options, results, progress);
+    }
+
+    filesystem::current_path(home);
+    // Only a directory this run created is removed
+    if (created && !options.keep) {
+        filesystem::remove_all(options.dir, ec);
+    }
+
+    if (options.jsonPath.empty()) {
+        return 0;
+    }
+    string json = suite_json(options, results);
+    if (options.jsonPath == "-") {
+        cout << json;
+    } else if (!write_file_atomic(options.jsonPath, json)) {
+        cerr << "Error: Unable to write " << options.jsonPath << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int run_suite_command(int argc, char* argv[]) {
+    SuiteOptions options;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scales" && hasValue) {
+            options.scales.clear();
+            stringstream list(argv[++i]);
+            string item;
+            while (getline(list, item, ',')) {
+                size_t count;
+                if (!parse_scale(item, count)) {
+                    cerr << "Error: invalid scale '" << item << "'" << endl;
+                    return 1;
+                }
+                options.scales.push_back(count);
+            }
+        } else if (arg == "--users" && hasValue) {
+            if (!parse_scale(argv[++i], options.users)) {
+                cerr << "Error: invalid user count" << endl;
+                return 1;
+            }
+        } else if (arg == "--runs" && hasValue) {
+            options.runs = max(1, atoi(argv[++i]));
+        } else if (arg == "--dir" && hasValue) {
+            options.dir = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " --suite [--scales 1k,10k,100k,1m,10m] [--users N]"
+                 << " [--runs N] [--dir DIR] [--json FILE|-] [--keep]" << endl;
+            return 1;
+        }
+    }
+    return run_suite(options);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--suite") {
+        return run_suite_command(argc, argv);
+    }
+    size_t count = argc > 1 ? stoul(argv[1]) : 1000000;
+
+    bench_parse(count);
+    bench_statistics(count * 10);
+    bench_persistence(count / 10, count);
+    bench_parallel(count * 4);
+    bench_descriptions(count);
+    return 0;
+}